@@ -0,0 +1,17 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+// Atomic operations, for data that is shared between search threads without locks.
+// The relaxed operations only guarantee that individual loads and stores are never torn, not any ordering between them.
+#define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define ATOMIC_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELAXED)
+#define ATOMIC_ADD(ptr, value) __atomic_add_fetch((ptr), (value), __ATOMIC_RELAXED)
+
+// Publishing data to other threads: everything written before a release store is visible after an acquire load of it
+#define ATOMIC_LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_RELEASE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+// Sets *ptr to desired if it equals expected. Returns whether it did.
+#define ATOMIC_COMPARE_EXCHANGE(ptr, expected, desired) \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitbase.h"
+#include "config.h"
+#include "constants.h"
+#include "context.h"
+#include "movegen.h"
+#include "hash.h"
+#include "position.h"
+
+#define BITBASE_FILE_MAGIC "CCHESSBB"
+// Increment this whenever the file layout, or the indexing of positions, changes
+#define BITBASE_FILE_VERSION 1
+
+// Bitbases are indexed by [strong side to move][strong king][weak king][strong piece], where the strong side is
+// the side with the extra piece. Each entry is 0 if the position is drawn (or impossible), and otherwise
+// 1 + the number of plies until the strong side mates.
+// Positions with the strong side as black are mirrored vertically, so the tables only hold white strong sides.
+#define BITBASE_SIZE (2 * 64 * 64 * 64)
+
+// Edges of the move graph that leave the bitbase being generated, to a position of a finished bitbase,
+// are stored as this plus that position's entry. Indices into the bitbase being generated are all smaller.
+#define BITBASE_EXTERNAL_EDGE (UINT32_MAX - 256)
+
+typedef enum {
+    // Tables that others promote into come first, so that they are generated first
+    BitbaseKQK = 0,
+    BitbaseKRK,
+    BitbaseKPK,
+    N_BITBASES,
+} BitbaseTable;
+
+static const PieceType BITBASE_PIECE_TYPES[N_BITBASES] = {Queen, Rook, Pawn};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_bitbases;
+    uint32_t bitbase_size;
+    uint32_t padding;
+} BitbaseFileHeader;
+
+static uint8_t bitbases[N_BITBASES][BITBASE_SIZE];
+// Whether the tables hold solved endings, and the file they were loaded from or saved to, if any
+static bool bitbases_available = false;
+static char *bitbase_path = NULL;
+
+void set_bitbase_path(const char *path) {
+    free(bitbase_path);
+    bitbase_path = NULL;
+    if (path != NULL) {
+        bitbase_path = malloc(strlen(path) + 1);
+        strcpy(bitbase_path, path);
+    }
+}
+
+// Finds the table and index of a position with two kings and one other piece.
+// Returns false for any other material, including a lone minor piece, which can't win.
+bool get_bitbase_index(PlyContext *context, BitbaseTable *table, uint32_t *index) {
+    Piece strong_piece = {NullPiece, 0, 0};
+    bool strong_is_white = true;
+    int n_pieces = 0;
+    for (int i = 0; i < 16; i++) {
+        if ((context->white_pieces[i].type != NullPiece) && (context->white_pieces[i].type != King)) {
+            strong_piece = context->white_pieces[i];
+            strong_is_white = true;
+            n_pieces++;
+        }
+        if ((context->black_pieces[i].type != NullPiece) && (context->black_pieces[i].type != King)) {
+            strong_piece = context->black_pieces[i];
+            strong_is_white = false;
+            n_pieces++;
+        }
+    }
+    if (n_pieces != 1)
+        return false;
+
+    switch (strong_piece.type) {
+        case Queen: *table = BitbaseKQK; break;
+        case Rook: *table = BitbaseKRK; break;
+        case Pawn: *table = BitbaseKPK; break;
+        default: return false;
+    }
+
+    // Kings never leave the king slot
+    Piece strong_king = strong_is_white ? context->white_pieces[4] : context->black_pieces[4];
+    Piece weak_king = strong_is_white ? context->black_pieces[4] : context->white_pieces[4];
+    uint8_t mirror = strong_is_white ? 0 : 56;
+    bool strong_to_move = context->is_white == strong_is_white;
+    *index = (((strong_to_move * 64 + (GET_PIECE_POS(strong_king) ^ mirror)) * 64
+        + (GET_PIECE_POS(weak_king) ^ mirror)) * 64) + (GET_PIECE_POS(strong_piece) ^ mirror);
+    return true;
+}
+
+// Sets up the position at an index of a table, with the strong side as white.
+// Returns false if the position is impossible.
+bool new_bitbase_context(PlyContext *context, BitbaseTable table, uint32_t index) {
+    uint8_t piece_pos = index % 64;
+    uint8_t weak_king_pos = (index / 64) % 64;
+    uint8_t strong_king_pos = (index / (64 * 64)) % 64;
+    bool strong_to_move = index / (64 * 64 * 64);
+    PieceType type = BITBASE_PIECE_TYPES[table];
+    if ((piece_pos == weak_king_pos) || (piece_pos == strong_king_pos) || (weak_king_pos == strong_king_pos))
+        return false;
+    if ((type == Pawn) && ((piece_pos / 8 == 0) || (piece_pos / 8 == 7)))
+        return false;
+
+    new_context(context);
+    for (int i = 0; i < 16; i++) {
+        context->white_pieces[i].type = NullPiece;
+        context->black_pieces[i].type = NullPiece;
+    }
+    context->white_can_castle_queen_side = false;
+    context->white_can_castle_king_side = false;
+    context->black_can_castle_queen_side = false;
+    context->black_can_castle_king_side = false;
+    context->white_pieces[4] = (Piece){King, strong_king_pos % 8, strong_king_pos / 8};
+    context->black_pieces[4] = (Piece){King, weak_king_pos % 8, weak_king_pos / 8};
+    // Pawns use the slot of their file, and other pieces the queen's slot
+    uint8_t slot = type == Pawn ? 8 + piece_pos % 8 : 3;
+    context->white_pieces[slot] = (Piece){type, piece_pos % 8, piece_pos / 8};
+
+    context->is_white = strong_to_move;
+    context->our_pieces = context->is_white ? context->white_pieces : context->black_pieces;
+    context->opponent_pieces = context->is_white ? context->black_pieces : context->white_pieces;
+    context->our_bb = 0;
+    context->opponent_bb = 0;
+    for (int i = 0; i < 16; i++) {
+        if (context->our_pieces[i].type != NullPiece)
+            context->our_bb |= GET_PIECE_BB_MASK(context->our_pieces[i]);
+        if (context->opponent_pieces[i].type != NullPiece)
+            context->opponent_bb |= GET_PIECE_BB_MASK(context->opponent_pieces[i]);
+    }
+    context->piece_bb = context->our_bb | context->opponent_bb;
+    context->hash = get_context_hash(context);
+    init_piece_scores(context);
+
+    // The side that just moved can't be in check
+    PlyContext passed;
+    new_scratch_branch(context, &passed, NULL_MOVE);
+    return !is_in_check(&passed);
+}
+
+// Retrograde analysis: a position is won in n plies if it is checkmate (n = 0), if the strong side has a move to a
+// position won in n - 1 plies, or if every move of the weak side leads to a position won in at most n - 1 plies.
+// Each pass finds the positions won in one more ply than the last, so every win gets its shortest mate,
+// and the positions left over once passes stop finding any are draws.
+// The move graph is generated once, so that each pass only has to look up the entries of the moves.
+void generate_bitbase(BitbaseTable table) {
+    uint8_t *entries = bitbases[table];
+    memset(entries, 0, BITBASE_SIZE);
+    uint32_t *edge_starts = malloc((BITBASE_SIZE + 1) * sizeof(uint32_t));
+    uint32_t edge_capacity = BITBASE_SIZE * 4;
+    uint32_t n_edges = 0;
+    uint32_t *edges = malloc(edge_capacity * sizeof(uint32_t));
+    // Passes must continue until mates through other bitbases, which may be long, have been reached
+    uint8_t max_external_entry = 0;
+
+    PlyContext context, branch;
+    for (uint32_t index = 0; index < BITBASE_SIZE; index++) {
+        edge_starts[index] = n_edges;
+        if (!new_bitbase_context(&context, table, index))
+            continue;
+
+        MoveList legal_moves = get_all_legal_moves(&context);
+        bool strong_to_move = context.is_white;
+        if ((legal_moves.n_moves == 0) && !strong_to_move && is_in_check(&context))
+            entries[index] = 1;
+
+        if (n_edges + legal_moves.n_moves > edge_capacity) {
+            edge_capacity *= 2;
+            edges = realloc(edges, edge_capacity * sizeof(uint32_t));
+        }
+        for (int i = 0; i < legal_moves.n_moves; i++) {
+            new_scratch_branch(&context, &branch, legal_moves.moves[i]);
+            BitbaseTable branch_table;
+            uint32_t branch_index;
+            if (!get_bitbase_index(&branch, &branch_table, &branch_index)) {
+                // Captures and minor promotions leave too little material to mate
+                edges[n_edges++] = BITBASE_EXTERNAL_EDGE;
+            } else if (branch_table != table) {
+                uint8_t entry = bitbases[branch_table][branch_index];
+                edges[n_edges++] = BITBASE_EXTERNAL_EDGE + entry;
+                if (entry > max_external_entry)
+                    max_external_entry = entry;
+            } else {
+                edges[n_edges++] = branch_index;
+            }
+        }
+        free(legal_moves.moves);
+    }
+    edge_starts[BITBASE_SIZE] = n_edges;
+
+    for (uint32_t plies = 1; plies <= BITBASE_MAX_PLIES; plies++) {
+        bool changed = false;
+        for (uint32_t index = 0; index < BITBASE_SIZE; index++) {
+            uint32_t start = edge_starts[index], end = edge_starts[index + 1];
+            if ((start == end) || (entries[index] != 0))
+                continue;
+
+            // The strong side needs one move that mates in time, and the weak side must have nothing but such moves.
+            // Entries found in this pass are too large to count, so each pass only extends mates by one ply.
+            bool strong_to_move = index >= BITBASE_SIZE / 2;
+            bool is_won = !strong_to_move;
+            for (uint32_t i = start; i < end; i++) {
+                uint32_t entry = edges[i] >= BITBASE_EXTERNAL_EDGE ? edges[i] - BITBASE_EXTERNAL_EDGE : entries[edges[i]];
+                bool is_edge_won = (entry != 0) && (entry <= plies);
+                if (is_edge_won == strong_to_move) {
+                    is_won = strong_to_move;
+                    break;
+                }
+            }
+            if (is_won) {
+                entries[index] = plies + 1;
+                changed = true;
+            }
+        }
+        if (!changed && (plies >= max_external_entry))
+            break;
+    }
+
+    free(edges);
+    free(edge_starts);
+}
+
+void generate_bitbases(void) {
+    // Positions must not be probed while their tables are being rewritten
+    bitbases_available = false;
+    for (int table = 0; table < N_BITBASES; table++) {
+        generate_bitbase(table);
+    }
+    bitbases_available = true;
+    set_bitbase_path(NULL);
+}
+
+bool save_bitbases(const char *path) {
+    if (!bitbases_available)
+        return false;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    BitbaseFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BITBASE_FILE_MAGIC, sizeof(header.magic));
+    header.version = BITBASE_FILE_VERSION;
+    header.n_bitbases = N_BITBASES;
+    header.bitbase_size = BITBASE_SIZE;
+    bool success = (fwrite(&header, sizeof(header), 1, file) == 1)
+        && (fwrite(bitbases, BITBASE_SIZE, N_BITBASES, file) == N_BITBASES);
+    success = (fclose(file) == 0) && success;
+    if (!success) {
+        remove(path);
+        return false;
+    }
+    set_bitbase_path(path);
+    return true;
+}
+
+bool load_bitbases(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    // Read into a separate buffer, so that a bad file leaves the current tables intact
+    uint8_t *loaded = malloc((size_t)N_BITBASES * BITBASE_SIZE);
+    BitbaseFileHeader header;
+    bool success = (loaded != NULL)
+        && (fread(&header, sizeof(header), 1, file) == 1)
+        && (memcmp(header.magic, BITBASE_FILE_MAGIC, sizeof(header.magic)) == 0)
+        && (header.version == BITBASE_FILE_VERSION)
+        && (header.n_bitbases == N_BITBASES)
+        && (header.bitbase_size == BITBASE_SIZE)
+        && (fread(loaded, BITBASE_SIZE, N_BITBASES, file) == N_BITBASES);
+    fclose(file);
+    if (success) {
+        memcpy(bitbases, loaded, (size_t)N_BITBASES * BITBASE_SIZE);
+        bitbases_available = true;
+        set_bitbase_path(path);
+    }
+    free(loaded);
+    return success;
+}
+
+void init_bitbases(void) {
+    load_bitbases(BITBASE_FILE);
+}
+
+bool are_bitbases_available(void) {
+    return bitbases_available;
+}
+
+const char *get_bitbase_path(void) {
+    return bitbase_path;
+}
+
+BitbaseResult probe_bitbase(PlyContext *context, int32_t *plies_to_mate) {
+    int n_pieces = __builtin_popcountll(context->piece_bb);
+    if ((n_pieces > 3) || !bitbases_available)
+        return BitbaseNone;
+
+    BitbaseTable table;
+    uint32_t index;
+    if (!get_bitbase_index(context, &table, &index) || (bitbases[table][index] == 0))
+        return BitbaseDraw;
+    *plies_to_mate = bitbases[table][index] - 1;
+    bool strong_to_move = index >= BITBASE_SIZE / 2;
+    return strong_to_move ? BitbaseWin : BitbaseLoss;
+}
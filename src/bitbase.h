@@ -0,0 +1,39 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "types.h"
+
+// The result of a position, from the point of view of the side to move
+typedef enum {
+    // The position has too many pieces for the bitbases, or they are unavailable
+    BitbaseNone = 0,
+    BitbaseWin,
+    BitbaseDraw,
+    BitbaseLoss,
+} BitbaseResult;
+
+// Bitbases hold the distance to mate of every won position, which also gives its win, draw or loss result.
+// Load the endgame bitbases from BITBASE_FILE, if it exists. They are never generated or saved implicitly,
+// so without the file, the search does without them until they are built or loaded.
+void init_bitbases(void);
+
+// Generate the bitbases by retrograde analysis, which takes a few seconds, without saving them
+void generate_bitbases(void);
+
+// Save or load the bitbases. Returns false on failure, if there are no bitbases to save,
+// or if the file was written by an incompatible build, in which case the current bitbases are kept.
+bool save_bitbases(const char *path);
+bool load_bitbases(const char *path);
+
+// Whether the bitbases have been generated or loaded
+bool are_bitbases_available(void);
+// The file that the bitbases were loaded from or saved to, or NULL if there is none
+const char *get_bitbase_path(void);
+
+// The exact result of a position with at most 3 pieces: king and pawn, rook or queen against a bare king,
+// or any position where neither side can mate. Castling and the 50-move rule are ignored.
+// Returns BitbaseNone for larger positions, and for every position if no bitbases are available.
+// Wins and losses also set plies_to_mate, the number of plies until mate with best play from both sides.
+BitbaseResult probe_bitbase(PlyContext *context, int32_t *plies_to_mate);
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BOOK_USE_MMAP
+#endif
+
+#include "book.h"
+#include "config.h"
+#include "context.h"
+#include "movegen.h"
+#include "position.h"
+#include "game.h"
+#include "timer.h"
+
+#define BOOK_FILE_MAGIC "CCHESSBK"
+// Increment this whenever the header, entry layout, or move encoding changes
+#define BOOK_FILE_VERSION 1
+
+// Moves are encoded as their origin square, target square, and promotion piece type (or 0), in 6, 6 and 4 bits.
+// Unlike a Move, this doesn't depend on which slot a piece occupies, which can differ between move orders.
+#define ENCODE_BOOK_MOVE(from, to, promotion) ((uint16_t)((from) | ((to) << 6) | ((promotion) << 12)))
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t n_entries;
+    // The hash of the starting position, which only matches if the book was built with the same hash keys
+    ContextHash start_hash;
+} BookFileHeader;
+
+// Entries are sorted by position hash, then by move, so that all moves of a position are adjacent
+typedef struct {
+    ContextHash hash;
+    uint16_t move;
+    // The number of games that played this move, saturated at UINT16_MAX
+    uint16_t weight;
+    uint32_t padding;
+} BookEntry;
+
+typedef struct {
+    char *path;
+    BookEntry *entries;
+    uint64_t n_entries;
+    // The mapped (or allocated) file, including its header
+    void *allocation;
+    uint64_t allocation_size;
+} OpeningBook;
+
+static OpeningBook book = {NULL, NULL, 0, NULL, 0};
+
+uint16_t encode_book_move(PlyContext *context, Move move) {
+    uint8_t from = GET_PIECE_POS(context->our_pieces[move.piece_id]);
+    uint8_t promotion = (move.special_move >= PromoteKnight) && (move.special_move <= PromoteQueen) ? move.special_move : 0;
+    return ENCODE_BOOK_MOVE(from, GET_MOVE_POS(move), promotion);
+}
+
+BookFileHeader new_book_file_header(uint64_t n_entries) {
+    PlyContext start;
+    new_context(&start);
+
+    BookFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_FILE_MAGIC, sizeof(header.magic));
+    header.version = BOOK_FILE_VERSION;
+    header.entry_size = sizeof(BookEntry);
+    header.n_entries = n_entries;
+    header.start_hash = start.hash;
+    return header;
+}
+
+bool is_valid_book_file_header(BookFileHeader *header, uint64_t file_size) {
+    BookFileHeader expected = new_book_file_header(header->n_entries);
+    return (memcmp(header->magic, expected.magic, sizeof(header->magic)) == 0)
+        && (header->version == expected.version)
+        && (header->entry_size == expected.entry_size)
+        && (header->start_hash == expected.start_hash)
+        && (file_size == sizeof(BookFileHeader) + header->n_entries * sizeof(BookEntry));
+}
+
+void close_book(void) {
+    if (book.allocation != NULL) {
+#ifdef BOOK_USE_MMAP
+        munmap(book.allocation, book.allocation_size);
+#else
+        free(book.allocation);
+#endif
+    }
+    free(book.path);
+    book = (OpeningBook){NULL, NULL, 0, NULL, 0};
+}
+
+bool open_book(const char *path) {
+    BookFileHeader header;
+    void *allocation;
+    uint64_t allocation_size;
+
+#ifdef BOOK_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) != 0) || (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+        || !is_valid_book_file_header(&header, file_stat.st_size)
+    ) {
+        close(fd);
+        return false;
+    }
+
+    // Only the pages touched by binary searches are ever read
+    allocation_size = file_stat.st_size;
+    allocation = mmap(NULL, allocation_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (allocation == MAP_FAILED)
+        return false;
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    long file_size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        file_size = ftell(file);
+    }
+    if ((file_size < 0) || (fseek(file, 0, SEEK_SET) != 0) || (fread(&header, sizeof(header), 1, file) != 1)
+        || !is_valid_book_file_header(&header, (uint64_t)file_size)
+    ) {
+        fclose(file);
+        return false;
+    }
+
+    allocation_size = file_size;
+    allocation = malloc(allocation_size);
+    if ((allocation == NULL) || (fseek(file, 0, SEEK_SET) != 0)
+        || (fread(allocation, 1, allocation_size, file) != allocation_size)
+    ) {
+        free(allocation);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+#endif
+
+    close_book();
+    book.path = malloc(strlen(path) + 1);
+    strcpy(book.path, path);
+    book.entries = (BookEntry *)((char *)allocation + sizeof(BookFileHeader));
+    book.n_entries = header.n_entries;
+    book.allocation = allocation;
+    book.allocation_size = allocation_size;
+    srand((unsigned)get_time_us());
+    return true;
+}
+
+const char *get_book_path(void) {
+    return book.path;
+}
+
+uint64_t get_book_size(void) {
+    return book.n_entries;
+}
+
+bool probe_book(PlyContext *context, Move *move) {
+    if (book.entries == NULL)
+        return false;
+
+    // Binary search for the first entry of this position
+    uint64_t low = 0, high = book.n_entries;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (book.entries[middle].hash < context->hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if ((low == book.n_entries) || (book.entries[low].hash != context->hash))
+        return false;
+
+    // Only consider moves that are legal here, in case another position shares the hash
+    MoveList legal_moves = get_all_legal_moves(context);
+    uint64_t total_weight = 0;
+    uint64_t end = low;
+    for (; (end < book.n_entries) && (book.entries[end].hash == context->hash); end++) {
+        for (int i = 0; i < legal_moves.n_moves; i++) {
+            if (encode_book_move(context, legal_moves.moves[i]) == book.entries[end].move) {
+                total_weight += book.entries[end].weight;
+                break;
+            }
+        }
+    }
+
+    bool found = false;
+    if (total_weight > 0) {
+        uint64_t choice = (uint64_t)rand() % total_weight;
+        for (uint64_t i = low; (i < end) && !found; i++) {
+            for (int j = 0; j < legal_moves.n_moves; j++) {
+                if (encode_book_move(context, legal_moves.moves[j]) != book.entries[i].move)
+                    continue;
+                if (choice < book.entries[i].weight) {
+                    *move = legal_moves.moves[j];
+                    found = true;
+                } else {
+                    choice -= book.entries[i].weight;
+                }
+                break;
+            }
+        }
+    }
+    free(legal_moves.moves);
+    return found;
+}
+
+int compare_book_entries(const void *a, const void *b) {
+    const BookEntry *entry_a = a, *entry_b = b;
+    if (entry_a->hash != entry_b->hash)
+        return entry_a->hash < entry_b->hash ? -1 : 1;
+    return (int)entry_a->move - (int)entry_b->move;
+}
+
+// Adds an entry for each of the first BOOK_MAX_PLY moves of a game, until an unrecognized move
+void add_book_game(char *line, BookEntry **entries, uint64_t *n_entries, uint64_t *capacity) {
+    PlyContext context;
+    new_context(&context);
+    char code[6];
+    int ply = 0;
+    for (char *token = strtok(line, " \t\r\n"); (token != NULL) && (ply < BOOK_MAX_PLY); token = strtok(NULL, " \t\r\n")) {
+        MoveList legal_moves = get_all_legal_moves(&context);
+        int move_i = -1;
+        for (int i = 0; i < legal_moves.n_moves; i++) {
+            get_move_code(&context, legal_moves.moves[i], code);
+            if (strcmp(code, token) == 0) {
+                move_i = i;
+                break;
+            }
+        }
+        if (move_i == -1) {
+            free(legal_moves.moves);
+            break;
+        }
+
+        if (*n_entries == *capacity) {
+            *capacity *= 2;
+            *entries = realloc(*entries, *capacity * sizeof(BookEntry));
+        }
+        (*entries)[(*n_entries)++] = (BookEntry){
+            .hash = context.hash,
+            .move = encode_book_move(&context, legal_moves.moves[move_i]),
+            .weight = 1,
+            .padding = 0
+        };
+        update_context_no_prefetch(&context, legal_moves.moves[move_i]);
+        free(legal_moves.moves);
+        ply++;
+    }
+}
+
+bool build_book(const char *path, const char **game_paths, int n_game_paths, uint32_t *n_games, uint64_t *n_entries) {
+    uint64_t capacity = 1024;
+    uint64_t n_raw_entries = 0;
+    BookEntry *entries = malloc(capacity * sizeof(BookEntry));
+    *n_games = 0;
+    *n_entries = 0;
+
+    char line[65536];
+    for (int i = 0; i < n_game_paths; i++) {
+        FILE *file = fopen(game_paths[i], "r");
+        if (file == NULL) {
+            free(entries);
+            return false;
+        }
+        while (fgets(line, sizeof(line), file)) {
+            if ((line[0] == '#') || (strspn(line, " \t\r\n") == strlen(line)))
+                continue;
+            add_book_game(line, &entries, &n_raw_entries, &capacity);
+            (*n_games)++;
+        }
+        fclose(file);
+    }
+
+    // Merge the entries of each position and move, summing their weights
+    qsort(entries, n_raw_entries, sizeof(BookEntry), compare_book_entries);
+    uint64_t n_merged = 0;
+    for (uint64_t i = 0; i < n_raw_entries; i++) {
+        if ((n_merged > 0) && (compare_book_entries(&entries[n_merged - 1], &entries[i]) == 0)) {
+            if (entries[n_merged - 1].weight < UINT16_MAX)
+                entries[n_merged - 1].weight++;
+        } else {
+            entries[n_merged++] = entries[i];
+        }
+    }
+
+    // Write to a temporary file first, since the book might be mapped from the destination file
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        free(entries);
+        return false;
+    }
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        free(entries);
+        return false;
+    }
+    BookFileHeader header = new_book_file_header(n_merged);
+    bool success = (fwrite(&header, sizeof(header), 1, file) == 1)
+        && (fwrite(entries, sizeof(BookEntry), n_merged, file) == n_merged);
+    success = (fclose(file) == 0) && success;
+    free(entries);
+    if (!success || (rename(tmp_path, path) != 0)) {
+        remove(tmp_path);
+        return false;
+    }
+    *n_entries = n_merged;
+    return true;
+}
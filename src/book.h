@@ -0,0 +1,29 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+// Map the opening book at path, replacing any book already open.
+// Returns false if the file can't be opened, or was built by an incompatible build.
+bool open_book(const char *path);
+
+void close_book(void);
+
+// The path and number of entries of the open book. The path is NULL if no book is open.
+const char *get_book_path(void);
+uint64_t get_book_size(void);
+
+// Pick a book move for the position at random, in proportion to the weights of its moves.
+// Returns false if no book is open, or the position has no legal book moves.
+bool probe_book(PlyContext *context, Move *move);
+
+// Build a book from files of games, written one per line as moves in algebraic coordinates (e.g., e2e4 e7e5 g1f3).
+// Each game's first BOOK_MAX_PLY moves are added, and each move is weighted by the number of games that play it.
+// A game ends at its first illegal or unrecognized move, and lines starting with '#' are ignored.
+// Returns false if a file can't be read or the book can't be written.
+bool build_book(const char *path, const char **game_paths, int n_game_paths, uint32_t *n_games, uint64_t *n_entries);
+
+#endif
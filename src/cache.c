@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CACHE_USE_MMAP
+#endif
+
+#include "cache.h"
+#include "config.h"
+#include "context.h"
+#include "hash.h"
+#include "atomic.h"
+
+// The number of entries in each bucket that are replaced based on depth.
+// The remaining entry is always replaced, so that recent results are never dropped entirely.
+#define CACHE_DEPTH_PREFERRED_ENTRIES (CACHE_BUCKET_ENTRIES - 1)
+
+// Generations wrap around within the 6 bits available in the data word
+#define CACHE_GENERATION_MASK 0x3F
+
+// Guards against overflow when converting to bytes
+#define MAX_MOVE_CACHE_SIZE_MB ((uint64_t)1 << 20)
+
+// The number of buckets sampled to estimate how full the cache is
+#define CACHE_FILL_SAMPLE_BUCKETS 1024
+
+// Huge pages on x86-64 and ARM64 Linux are 2 MB
+#define HUGE_PAGE_SIZE ((uint64_t)2 * 1024 * 1024)
+
+typedef struct {
+    CacheBucket *buckets;
+    // The number of buckets is a power of two, so this masks a hash into a bucket index
+    uint64_t index_mask;
+    uint8_t generation;
+
+    // The underlying allocation, which may be larger than the buckets themselves due to alignment
+    void *allocation;
+    uint64_t allocation_size;
+    CacheMemory memory;
+} MoveCache;
+
+///// File Format /////
+// A cache file is this header, followed by the buckets exactly as they are laid out in memory.
+// Values are stored in native byte order. The header fills one bucket, so the buckets stay aligned when mapped.
+
+#define CACHE_FILE_MAGIC "CCHESSTT"
+// Increment this whenever the header, bucket, or entry layout changes
+#define CACHE_FILE_VERSION 3
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    // sizeof(CacheBucket), to catch layout differences between builds
+    uint32_t bucket_size;
+    uint64_t n_buckets;
+    // The hash of the starting position. Cached entries are only meaningful with identical hash keys.
+    uint64_t start_hash;
+    uint8_t generation;
+    uint8_t padding[31];
+} CacheFileHeader;
+
+static MoveCache move_cache = {NULL, 0, 0, NULL, 0, CacheMemoryNone};
+
+///// Packing /////
+// Data word layout (low to high): score (32 bits), move (16 bits), depth (8 bits), bound (2 bits), generation (6 bits)
+
+uint16_t pack_move(Move move) {
+    return move.piece_id | (move.to_x << 4) | (move.to_y << 7) | (move.special_move << 10);
+}
+
+Move unpack_move(uint16_t packed) {
+    return (Move){
+        .piece_id = packed & 0xF,
+        .to_x = (packed >> 4) & 0x7,
+        .to_y = (packed >> 7) & 0x7,
+        .special_move = (packed >> 10) & 0xF
+    };
+}
+
+uint64_t pack_entry(Move move, int32_t score, uint8_t depth, CacheBound bound, uint8_t generation) {
+    return (uint64_t)(uint32_t)score
+        | ((uint64_t)pack_move(move) << 32)
+        | ((uint64_t)depth << 48)
+        | ((uint64_t)bound << 56)
+        | ((uint64_t)generation << 58);
+}
+
+#define GET_ENTRY_SCORE(data) ((int32_t)(uint32_t)(data))
+#define GET_ENTRY_MOVE(data) unpack_move((uint16_t)((data) >> 32))
+#define GET_ENTRY_DEPTH(data) ((uint8_t)((data) >> 48))
+#define GET_ENTRY_BOUND(data) ((uint8_t)(((data) >> 56) & 0x3))
+#define GET_ENTRY_GENERATION(data) ((uint8_t)((data) >> 58))
+
+///// Indexing /////
+
+// The low bits of a hash select its bucket, and the high bits verify which position an entry belongs to.
+// The two never overlap, since the cache can never hold 2^48 buckets.
+#define GET_BUCKET(hash) (&move_cache.buckets[(hash) & move_cache.index_mask])
+#define GET_TAG(hash) ((uint16_t)((hash) >> 48))
+
+///// Lockless Access /////
+// Search threads share the cache without locks. Each entry's tag is stored XORed with a fold of its data word,
+// so if two threads write an entry at once and a reader sees one's tag with the other's data, the entry is rejected.
+
+#define FOLD_DATA(data) ((uint16_t)((data) ^ ((data) >> 16) ^ ((data) >> 32) ^ ((data) >> 48)))
+
+// Reads an entry's data word, returning false if the entry is empty or belongs to another position
+bool read_entry(CacheBucket *bucket, int i, uint16_t tag, uint64_t *data) {
+    *data = ATOMIC_LOAD(&bucket->data[i]);
+    uint16_t stored_tag = ATOMIC_LOAD(&bucket->tags[i]);
+    return ((stored_tag ^ FOLD_DATA(*data)) == tag) && (GET_ENTRY_BOUND(*data) != BoundNone);
+}
+
+void write_entry(CacheBucket *bucket, int i, uint16_t tag, uint64_t data) {
+    ATOMIC_STORE(&bucket->data[i], data);
+    ATOMIC_STORE(&bucket->tags[i], (uint16_t)(tag ^ FOLD_DATA(data)));
+}
+
+///// Allocation /////
+
+// Allocate zeroed memory for the buckets, preferring huge pages to reduce TLB misses on random probes.
+// Returns NULL on failure.
+CacheBucket *allocate_buckets(uint64_t size, void **allocation, uint64_t *allocation_size, CacheMemory *memory) {
+#ifdef CACHE_USE_MMAP
+    // Mappings are page-aligned, which is more than enough for the buckets
+    uint64_t mapped_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void *mapped;
+
+#ifdef MAP_HUGETLB
+    // Explicit huge pages, which are only available if the system has reserved some
+    mapped = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapped != MAP_FAILED) {
+        *allocation = mapped;
+        *allocation_size = mapped_size;
+        *memory = CacheMemoryHugePages;
+        return mapped;
+    }
+#endif
+
+    mapped = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped != MAP_FAILED) {
+        *allocation = mapped;
+        *allocation_size = mapped_size;
+        *memory = CacheMemoryPages;
+#ifdef MADV_HUGEPAGE
+        // Ask for transparent huge pages instead
+        if (madvise(mapped, mapped_size, MADV_HUGEPAGE) == 0) {
+            *memory = CacheMemoryTransparentHugePages;
+        }
+#endif
+        return mapped;
+    }
+#endif
+
+    // Fall back to the heap, aligning the buckets to cache lines by hand
+    void *allocated = calloc(1, size + sizeof(CacheBucket));
+    if (allocated == NULL)
+        return NULL;
+    *allocation = allocated;
+    *allocation_size = size + sizeof(CacheBucket);
+    *memory = CacheMemoryHeap;
+    uintptr_t aligned = ((uintptr_t)allocated + sizeof(CacheBucket) - 1) & ~(uintptr_t)(sizeof(CacheBucket) - 1);
+    return (CacheBucket *)aligned;
+}
+
+void release_buckets(void *allocation, uint64_t allocation_size, CacheMemory memory) {
+    switch (memory) {
+#ifdef CACHE_USE_MMAP
+        case CacheMemoryHugePages:
+        case CacheMemoryTransparentHugePages:
+        case CacheMemoryPages:
+        case CacheMemoryFile:
+            munmap(allocation, allocation_size);
+            break;
+#endif
+        case CacheMemoryHeap:
+            free(allocation);
+            break;
+        default:
+            (void)allocation_size;
+            break;
+    }
+}
+
+///// Public Interface /////
+
+void init_cache(void) {
+    resize_cache(DEFAULT_MOVE_CACHE_SIZE_MB);
+}
+
+bool resize_cache(uint64_t size_mb) {
+    if ((size_mb == 0) || (size_mb > MAX_MOVE_CACHE_SIZE_MB))
+        return false;
+
+    // Round down to a power of two, so that indexing is a mask rather than a division
+    uint64_t size_bytes = size_mb * 1024 * 1024;
+    uint64_t n_buckets = 1;
+    while ((n_buckets << 1) * sizeof(CacheBucket) <= size_bytes) {
+        n_buckets <<= 1;
+    }
+
+    void *allocation;
+    uint64_t allocation_size;
+    CacheMemory memory;
+    CacheBucket *buckets = allocate_buckets(n_buckets * sizeof(CacheBucket), &allocation, &allocation_size, &memory);
+    // Keep the current table if the new one can't be allocated
+    if (buckets == NULL)
+        return false;
+
+    free_cache();
+    move_cache.buckets = buckets;
+    move_cache.index_mask = n_buckets - 1;
+    move_cache.generation = 0;
+    move_cache.allocation = allocation;
+    move_cache.allocation_size = allocation_size;
+    move_cache.memory = memory;
+    clear_cache();
+    return true;
+}
+
+void free_cache(void) {
+    release_buckets(move_cache.allocation, move_cache.allocation_size, move_cache.memory);
+    move_cache.buckets = NULL;
+    move_cache.index_mask = 0;
+    move_cache.allocation = NULL;
+    move_cache.allocation_size = 0;
+    move_cache.memory = CacheMemoryNone;
+}
+
+uint64_t get_cache_size_bytes(void) {
+    return move_cache.buckets == NULL ? 0 : (move_cache.index_mask + 1) * sizeof(CacheBucket);
+}
+
+CacheMemory get_cache_memory(void) {
+    return move_cache.memory;
+}
+
+const char *get_cache_memory_name(CacheMemory memory) {
+    switch (memory) {
+        case CacheMemoryHugePages:
+            return "huge pages";
+        case CacheMemoryTransparentHugePages:
+            return "transparent huge pages";
+        case CacheMemoryPages:
+            return "regular pages";
+        case CacheMemoryHeap:
+            return "heap";
+        case CacheMemoryFile:
+            return "mapped file";
+        default:
+            return "unallocated";
+    }
+}
+
+CacheFileHeader new_cache_file_header(void) {
+    PlyContext start;
+    new_context(&start);
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_FILE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_FILE_VERSION;
+    header.bucket_size = sizeof(CacheBucket);
+    header.n_buckets = move_cache.index_mask + 1;
+    header.start_hash = start.hash;
+    header.generation = move_cache.generation;
+    return header;
+}
+
+CacheFileStatus save_cache(const char *path) {
+    if (move_cache.buckets == NULL)
+        return CacheFileWriteFailed;
+
+    // Write to a temporary file first.
+    // The cache might be mapped from the destination file, which must not be truncated while in use.
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+        return CacheFileWriteFailed;
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL)
+        return CacheFileOpenFailed;
+
+    CacheFileHeader header = new_cache_file_header();
+    bool success = (fwrite(&header, sizeof(header), 1, file) == 1)
+        && (fwrite(move_cache.buckets, sizeof(CacheBucket), header.n_buckets, file) == header.n_buckets);
+    success = (fclose(file) == 0) && success;
+    if (!success || (rename(tmp_path, path) != 0)) {
+        remove(tmp_path);
+        return CacheFileWriteFailed;
+    }
+    return CacheFileOk;
+}
+
+// Checks that a header was written by a compatible build, with the same hash keys
+CacheFileStatus validate_cache_file_header(CacheFileHeader *header, uint64_t file_size) {
+    if (memcmp(header->magic, CACHE_FILE_MAGIC, sizeof(header->magic)) != 0)
+        return CacheFileInvalid;
+    if ((header->version != CACHE_FILE_VERSION) || (header->bucket_size != sizeof(CacheBucket)))
+        return CacheFileIncompatible;
+
+    // The bucket count must be a power of two, and match the file size
+    uint64_t n_buckets = header->n_buckets;
+    if ((n_buckets == 0) || ((n_buckets & (n_buckets - 1)) != 0)
+        || (n_buckets > (MAX_MOVE_CACHE_SIZE_MB * 1024 * 1024) / sizeof(CacheBucket))
+        || (file_size != sizeof(CacheFileHeader) + n_buckets * sizeof(CacheBucket))
+    ) {
+        return CacheFileInvalid;
+    }
+
+    CacheFileHeader expected = new_cache_file_header();
+    if (header->start_hash != expected.start_hash)
+        return CacheFileIncompatible;
+    return CacheFileOk;
+}
+
+CacheFileStatus load_cache(const char *path) {
+    CacheFileHeader header;
+    void *allocation;
+    uint64_t allocation_size;
+    CacheMemory memory;
+    CacheBucket *buckets;
+
+#ifdef CACHE_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return CacheFileOpenFailed;
+
+    struct stat file_stat;
+    if ((fstat(fd, &file_stat) != 0) || (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))) {
+        close(fd);
+        return CacheFileInvalid;
+    }
+    CacheFileStatus status = validate_cache_file_header(&header, file_stat.st_size);
+    if (status != CacheFileOk) {
+        close(fd);
+        return status;
+    }
+
+    // Map the file copy-on-write, so that the search can keep updating the table without modifying the file.
+    // Pages are read in on demand, so the table is usable immediately.
+    allocation_size = file_stat.st_size;
+    allocation = mmap(NULL, allocation_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (allocation == MAP_FAILED)
+        return CacheFileOpenFailed;
+#ifdef MADV_WILLNEED
+    // Start reading the rest of the file in the background
+    madvise(allocation, allocation_size, MADV_WILLNEED);
+#endif
+    memory = CacheMemoryFile;
+    buckets = (CacheBucket *)((char *)allocation + sizeof(CacheFileHeader));
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return CacheFileOpenFailed;
+
+    long file_size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        file_size = ftell(file);
+    }
+    if ((file_size < 0) || (fseek(file, 0, SEEK_SET) != 0) || (fread(&header, sizeof(header), 1, file) != 1)) {
+        fclose(file);
+        return CacheFileInvalid;
+    }
+    CacheFileStatus status = validate_cache_file_header(&header, (uint64_t)file_size);
+    if (status != CacheFileOk) {
+        fclose(file);
+        return status;
+    }
+
+    buckets = allocate_buckets(header.n_buckets * sizeof(CacheBucket), &allocation, &allocation_size, &memory);
+    if (buckets == NULL) {
+        fclose(file);
+        return CacheFileOpenFailed;
+    }
+    if (fread(buckets, sizeof(CacheBucket), header.n_buckets, file) != header.n_buckets) {
+        fclose(file);
+        release_buckets(allocation, allocation_size, memory);
+        return CacheFileInvalid;
+    }
+    fclose(file);
+#endif
+
+    free_cache();
+    move_cache.buckets = buckets;
+    move_cache.index_mask = header.n_buckets - 1;
+    move_cache.generation = header.generation;
+    move_cache.allocation = allocation;
+    move_cache.allocation_size = allocation_size;
+    move_cache.memory = memory;
+    return CacheFileOk;
+}
+
+const char *get_cache_file_status_name(CacheFileStatus status) {
+    switch (status) {
+        case CacheFileOk:
+            return "success";
+        case CacheFileOpenFailed:
+            return "could not open file";
+        case CacheFileWriteFailed:
+            return "could not write file";
+        case CacheFileInvalid:
+            return "not a valid cache file";
+        case CacheFileIncompatible:
+            return "cache file was saved by an incompatible version";
+        default:
+            return "unknown error";
+    }
+}
+
+void clear_cache(void) {
+    if (move_cache.buckets != NULL) {
+        memset(move_cache.buckets, 0, (move_cache.index_mask + 1) * sizeof(CacheBucket));
+    }
+}
+
+void new_cache_search(void) {
+    move_cache.generation = (move_cache.generation + 1) & CACHE_GENERATION_MASK;
+}
+
+uint32_t get_cache_fill_permille(void) {
+    if (move_cache.buckets == NULL)
+        return 0;
+
+    uint64_t n_buckets = move_cache.index_mask + 1;
+    uint64_t n_sampled = n_buckets < CACHE_FILL_SAMPLE_BUCKETS ? n_buckets : CACHE_FILL_SAMPLE_BUCKETS;
+    uint64_t n_filled = 0;
+    for (uint64_t i = 0; i < n_sampled; i++) {
+        for (int j = 0; j < CACHE_BUCKET_ENTRIES; j++) {
+            uint64_t data = ATOMIC_LOAD(&move_cache.buckets[i].data[j]);
+            if ((GET_ENTRY_BOUND(data) != BoundNone) && (GET_ENTRY_GENERATION(data) == move_cache.generation))
+                n_filled++;
+        }
+    }
+    return (uint32_t)((n_filled * 1000) / (n_sampled * CACHE_BUCKET_ENTRIES));
+}
+
+bool probe_cache(ContextHash hash, CacheEntry *entry) {
+    if (move_cache.buckets == NULL)
+        return false;
+
+    CacheBucket *bucket = GET_BUCKET(hash);
+    uint16_t tag = GET_TAG(hash);
+    for (int i = 0; i < CACHE_BUCKET_ENTRIES; i++) {
+        uint64_t data;
+        if (read_entry(bucket, i, tag, &data)) {
+            entry->move = GET_ENTRY_MOVE(data);
+            entry->score = GET_ENTRY_SCORE(data);
+            entry->depth = GET_ENTRY_DEPTH(data);
+            entry->bound = GET_ENTRY_BOUND(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void store_cache(ContextHash hash, Move move, int32_t score, uint8_t depth, CacheBound bound) {
+    if (move_cache.buckets == NULL)
+        return;
+
+    CacheBucket *bucket = GET_BUCKET(hash);
+    uint16_t tag = GET_TAG(hash);
+
+    // If the position is already cached, only overwrite it with a result that is at least as useful
+    for (int i = 0; i < CACHE_BUCKET_ENTRIES; i++) {
+        uint64_t data;
+        if (!read_entry(bucket, i, tag, &data))
+            continue;
+
+        if ((depth < GET_ENTRY_DEPTH(data))
+            && (bound != BoundExact)
+            && (GET_ENTRY_GENERATION(data) == move_cache.generation)
+        ) {
+            return;
+        }
+        // Keep the previous best move, rather than forgetting it
+        if (move.special_move == NullMove) {
+            move = GET_ENTRY_MOVE(data);
+        }
+        write_entry(bucket, i, tag, pack_entry(move, score, depth, bound, move_cache.generation));
+        return;
+    }
+
+    // Otherwise, find the least valuable depth-preferred entry.
+    // Entries from previous searches are worth less than their depth suggests.
+    int replace_i = 0;
+    int32_t replace_worth = INT32_MAX;
+    for (int i = 0; i < CACHE_DEPTH_PREFERRED_ENTRIES; i++) {
+        uint64_t data = ATOMIC_LOAD(&bucket->data[i]);
+        if (GET_ENTRY_BOUND(data) == BoundNone) {
+            replace_i = i;
+            replace_worth = -1;
+            break;
+        }
+        uint8_t age = (move_cache.generation - GET_ENTRY_GENERATION(data)) & CACHE_GENERATION_MASK;
+        int32_t worth = GET_ENTRY_DEPTH(data) - 8 * age;
+        if (worth < replace_worth) {
+            replace_i = i;
+            replace_worth = worth;
+        }
+    }
+
+    // Shallower results go in the always-replace entry, rather than evicting deeper ones
+    if (depth < replace_worth) {
+        replace_i = CACHE_BUCKET_ENTRIES - 1;
+    }
+    write_entry(bucket, replace_i, tag, pack_entry(move, score, depth, bound, move_cache.generation));
+}
+
+void prefetch_cache(ContextHash hash) {
+#if defined(__GNUC__) || defined(__clang__)
+    if (move_cache.buckets != NULL) {
+        __builtin_prefetch(GET_BUCKET(hash));
+    }
+#else
+    (void)hash;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+
+// How a cached score relates to the true score of its position
+typedef enum {
+    // The entry holds no usable score
+    BoundNone = 0,
+    // The true score is at most the cached score (every move failed low)
+    BoundUpper = 1,
+    // The true score is at least the cached score (a move failed high)
+    BoundLower = 2,
+    // The cached score is the true score
+    BoundExact = 3,
+} CacheBound;
+
+// The number of entries that share one 64-byte bucket
+#define CACHE_BUCKET_ENTRIES 6
+
+// Entries are split into a 16-bit verification tag and a packed data word, so that a bucket fills exactly one cache line.
+// The data word holds the score, best move, depth, bound, and search generation of the entry.
+// The tag is stored XORed with a fold of the data word, so that entries torn by concurrent writes are detected.
+typedef struct {
+    uint64_t data[CACHE_BUCKET_ENTRIES];
+    uint16_t tags[CACHE_BUCKET_ENTRIES];
+    uint16_t padding[2];
+} CacheBucket;
+
+// An unpacked cache entry
+typedef struct {
+    // The best (or refuting) move found, or NULL_MOVE at leaves
+    Move move;
+    // Mate scores are stored relative to the cached node, rather than the root
+    int32_t score;
+    uint8_t depth;
+    uint8_t bound;
+} CacheEntry;
+
+// The kind of memory backing the move cache
+typedef enum {
+    CacheMemoryNone = 0,
+    // Explicitly reserved huge pages (MAP_HUGETLB)
+    CacheMemoryHugePages,
+    // Regular pages, with the kernel asked to back them with transparent huge pages
+    CacheMemoryTransparentHugePages,
+    // Regular pages
+    CacheMemoryPages,
+    // Heap memory, when memory mapping is unavailable
+    CacheMemoryHeap,
+    // A copy-on-write mapping of a saved cache file
+    CacheMemoryFile,
+} CacheMemory;
+
+typedef enum {
+    CacheFileOk = 0,
+    CacheFileOpenFailed,
+    CacheFileWriteFailed,
+    // The file is not a cache file, or is corrupted
+    CacheFileInvalid,
+    // The file is a cache file, but its format or hash keys differ from this build
+    CacheFileIncompatible,
+} CacheFileStatus;
+
+// Allocate the global move cache with its default size
+void init_cache(void);
+
+// Reallocate the move cache to the largest power-of-two size that fits in the given number of megabytes.
+// The cache is emptied. Returns false, leaving the current cache untouched, if the allocation fails.
+bool resize_cache(uint64_t size_mb);
+
+// Free the global move cache
+void free_cache(void);
+
+uint64_t get_cache_size_bytes(void);
+
+CacheMemory get_cache_memory(void);
+
+const char *get_cache_memory_name(CacheMemory memory);
+
+// Save the move cache to a file
+CacheFileStatus save_cache(const char *path);
+
+// Replace the move cache with one saved by save_cache.
+// Where possible, the file is memory-mapped rather than read, so that large caches load almost instantly.
+CacheFileStatus load_cache(const char *path);
+
+const char *get_cache_file_status_name(CacheFileStatus status);
+
+// Remove all entries from the move cache
+void clear_cache(void);
+
+// Start a new search, so that entries from previous searches are replaced first
+void new_cache_search(void);
+
+// Estimate the permille of entries written during the current search, by sampling the first buckets
+uint32_t get_cache_fill_permille(void);
+
+// Look up a position in the move cache. Returns false if it is not present.
+bool probe_cache(ContextHash hash, CacheEntry *entry);
+
+// Save a search result in the move cache, subject to the replacement policy
+void store_cache(ContextHash hash, Move move, int32_t score, uint8_t depth, CacheBound bound);
+
+// Start loading a position's bucket into the CPU cache, before it is probed
+void prefetch_cache(ContextHash hash);
+
+#endif
\ No newline at end of file
@@ -12,16 +12,136 @@
 #define WIN_VALUE 1000000
 #define LOSS_VALUE -1000000
 #define DRAW_VALUE -100
+// Static evaluations are clamped to this range, so that they can never be mistaken for mate scores
+#define MAX_EVAL_VALUE (WIN_VALUE / 2)
 
 ///// Other Evaluation Values /////
 #define PIECE_POSSIBLE_MOVES_BONUS_MULTIPLIER 20
 #define PAWN_Y_VALUE_BONUS 30
+// In the endgame, pawns are worth more as they advance, and the king is worth more near the center
+#define ENDGAME_PAWN_Y_VALUE_BONUS 60
+#define ENDGAME_KING_POSSIBLE_MOVES_BONUS_MULTIPLIER 40
+// Pawn structure. Passed pawns gain these bonuses for each rank they have advanced.
+#define PASSED_PAWN_Y_VALUE_BONUS 20
+#define ENDGAME_PASSED_PAWN_Y_VALUE_BONUS 60
+#define ISOLATED_PAWN_PENALTY 120
+#define ENDGAME_ISOLATED_PAWN_PENALTY 150
+// Applied to every pawn on a file beyond the first
+#define DOUBLED_PAWN_PENALTY 100
+#define ENDGAME_DOUBLED_PAWN_PENALTY 150
+#define BACKWARD_PAWN_PENALTY 80
+#define ENDGAME_BACKWARD_PAWN_PENALTY 60
+// The number of entries in the pawn structure cache. It must be a power of two.
+#define PAWN_CACHE_ENTRIES (1 << 14)
+// Leaves only check for stalemate when the side to move has at most this many pieces, including the king.
+// With more pieces, running out of moves is rare enough to leave to the search's interior nodes.
+#define LEAF_STALEMATE_MAX_PIECES 4
 
 ///// Game Configuration /////
 #define DEFAULT_LOCK_DISPLAY false
 #define SHOW_EVALUATION false
+// Whether to search on the opponent's time by default. It can be changed at runtime with the `ponder` command.
+#define DEFAULT_PONDER false
+// The default maximum search depth. It can be changed at runtime with the `depth` command.
 #define MOVE_SEARCH_DEPTH 5
-#define MOVE_CACHE_SIZE_BYTES (uint64_t)(256 * 1024 * 1024)
+// The move cache can also be resized at runtime with the `hash` command
+#define DEFAULT_MOVE_CACHE_SIZE_MB 256
 #define MAX_GAME_PLY 1024
+#define MAX_SEARCH_PLY 128
+
+///// Search Configuration /////
+// Captures in quiescence search are skipped if, even after winning the captured piece and this much more,
+// they could not raise the score to the best score found so far
+#define DELTA_PRUNING_MARGIN 2000
+
+// Root searches start with a window this far either side of the previous iteration's score.
+// It doubles every time the score falls outside of it.
+#define ASPIRATION_WINDOW 60
+// Shallower iterations are searched with a full window
+#define ASPIRATION_MIN_DEPTH 4
+
+// Null move pruning is used from this depth on, reducing the null move's search by
+// NULL_MOVE_BASE_REDUCTION + depth / NULL_MOVE_DEPTH_DIVISOR ply
+#define NULL_MOVE_MIN_DEPTH 3
+#define NULL_MOVE_BASE_REDUCTION 2
+#define NULL_MOVE_DEPTH_DIVISOR 6
+// Null move cutoffs from this depth on are verified with a reduced search without null moves
+#define NULL_MOVE_VERIFICATION_DEPTH 6
+
+// Late quiet moves are reduced by LATE_MOVE_REDUCTION_BASE + ln(depth) * ln(move index) / LATE_MOVE_REDUCTION_DIVISOR ply,
+// from this depth and move index on
+#define LATE_MOVE_REDUCTION_MIN_DEPTH 3
+#define LATE_MOVE_REDUCTION_MIN_MOVES 3
+#define LATE_MOVE_REDUCTION_BASE 0.75
+#define LATE_MOVE_REDUCTION_DIVISOR 2.25
+
+// Margins are in evaluation units, where a pawn is worth roughly 250 with all pieces on the board.
+// Each technique can also be toggled at runtime with the `prune` command.
+// Futility pruning skips quiet moves at depth <= FUTILITY_MAX_DEPTH, if the static evaluation plus
+// FUTILITY_MARGIN * depth can't reach the floor
+#define USE_FUTILITY_PRUNING true
+#define FUTILITY_MAX_DEPTH 2
+#define FUTILITY_MARGIN 300
+// Razoring drops into a quiescence search at depth <= RAZORING_MAX_DEPTH, if the static evaluation plus
+// RAZORING_MARGIN * depth can't reach the floor
+#define USE_RAZORING true
+#define RAZORING_MAX_DEPTH 2
+#define RAZORING_MARGIN 500
+// Late move pruning skips quiet moves at depth <= LATE_MOVE_PRUNING_MAX_DEPTH, after
+// LATE_MOVE_PRUNING_BASE_MOVES + depth^2 moves have been searched
+#define USE_LATE_MOVE_PRUNING true
+#define LATE_MOVE_PRUNING_MAX_DEPTH 3
+#define LATE_MOVE_PRUNING_BASE_MOVES 4
+
+// Each search thread checks its limits and stop requests every this many nodes. This must be a power of two.
+#define SEARCH_CHECK_INTERVAL 1024
+
+// The most lines that a multi-PV search can find
+#define MAX_MULTI_PV 16
+
+// The most threads that a search can use. The default is 1, and can be changed with the `threads` command.
+#define MAX_SEARCH_THREADS 256
+
+///// Opening Book /////
+// The opening book that is opened at startup, if it exists. Other books can be opened with the `book` command.
+#define BOOK_FILE "book.bin"
+// Whether to play book moves by default. It can be changed at runtime with the `book` command.
+#define DEFAULT_USE_BOOK true
+// Books only hold the first moves of each game, up to this many plies
+#define BOOK_MAX_PLY 24
+
+///// Endgame Bitbases /////
+// Bitbases for king and pawn, rook or queen against a bare king are loaded from this file at startup, if it exists.
+// `bitbase build` saves them here by default.
+#define BITBASE_FILE "bitbases.bin"
+
+///// Monte Carlo Tree Search /////
+// The memory used by the tree of the `search mcts` backend
+#define MCTS_MEMORY_MB 64
+// The number of playouts per move when no node, time or clock limit is set
+#define MCTS_DEFAULT_PLAYOUTS 20000
+// How strongly PUCT selection favours moves with high priors and few visits, over moves with good results
+#define MCTS_EXPLORATION 1.5
+// Leaves are scored as tanh(evaluation / MCTS_EVAL_SCALE), so that results lie between -1 (loss) and 1 (win)
+#define MCTS_EVAL_SCALE 1000.0
+// The prior of captures that don't lose material, and of promotions, relative to other moves
+#define MCTS_TACTICAL_PRIOR 4.0
+// The number of losses temporarily added to a node while another thread's playout passes through it,
+// so that threads spread out over different branches
+#define MCTS_VIRTUAL_LOSS 3
+
+///// Mate Search /////
+// The memory used by the proof-number search of the `mate` command
+#define MATE_SEARCH_MEMORY_MB 64
+// The longest mate that the `mate` command can search for, in moves
+#define MAX_MATE_MOVES 16
+
+///// Time Management /////
+// When playing on a clock, plan to spend this fraction of the remaining time on each move
+#define CLOCK_MOVES_TO_GO 30
+// An iteration may run up to this many times longer than planned before it is aborted
+#define CLOCK_HARD_LIMIT_MULTIPLIER 4
+// Time that is never used, to allow for overhead outside of the search
+#define CLOCK_SAFETY_MARGIN_MS 50
 
 #endif
\ No newline at end of file
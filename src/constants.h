@@ -3,8 +3,19 @@
 
 #include <stdint.h>
 
+#include "config.h"
+
 static const int32_t N_REPETITIONS_DRAW = 3;
 
+///// Search Scores /////
+// Larger than any score that a search can return
+static const int32_t SCORE_INFINITY = 1000000000;
+// The longest mate, in plies, that a bitbase entry can hold
+#define BITBASE_MAX_PLIES 254
+// Scores at least this far from zero are forced mates, and encode the distance to mate.
+// Mates found in the bitbases can be up to BITBASE_MAX_PLIES beyond the deepest ply of the search.
+static const int32_t MATE_SCORE_THRESHOLD = WIN_VALUE - MAX_SEARCH_PLY - BITBASE_MAX_PLIES;
+
 ///// Maximum Moves /////
 // These are the maximum possible moves that each piece can make in one ply.
 // These values are used for allocating memory for MoveLists.
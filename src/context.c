@@ -4,6 +4,34 @@
 #include "context.h"
 #include "position.h"
 #include "hash.h"
+#include "cache.h"
+#include "eval.h"
+
+// Adds a piece's piece-square scores and game phase to the context, or removes them if sign is -1.
+// Pawns are also added to or removed from the pawn hash.
+void update_piece_scores(PlyContext *context, Piece piece, bool is_white, int32_t sign) {
+    uint8_t pos = GET_PIECE_POS(piece);
+    context->middlegame_scores[is_white] += sign * MIDDLEGAME_PIECE_SQUARE_TABLE[is_white][piece.type][pos];
+    context->endgame_scores[is_white] += sign * ENDGAME_PIECE_SQUARE_TABLE[is_white][piece.type][pos];
+    context->game_phase += sign * GAME_PHASE_WEIGHTS[piece.type];
+    if (piece.type == Pawn)
+        UPDATE_HASH(context->pawn_hash, get_piece_hash(piece, is_white))
+}
+
+void init_piece_scores(PlyContext *context) {
+    for (int is_white = 0; is_white < 2; is_white++) {
+        context->middlegame_scores[is_white] = 0;
+        context->endgame_scores[is_white] = 0;
+    }
+    context->game_phase = 0;
+    context->pawn_hash = 0;
+    for (int i = 0; i < 16; i++) {
+        if (context->white_pieces[i].type != NullPiece)
+            update_piece_scores(context, context->white_pieces[i], true, 1);
+        if (context->black_pieces[i].type != NullPiece)
+            update_piece_scores(context, context->black_pieces[i], false, 1);
+    }
+}
 
 // Create a new PlyContext of a board in its default state, and white to play
 void new_context(PlyContext *context) {
@@ -62,6 +90,8 @@ void new_context(PlyContext *context) {
     context->piece_bb = context->our_bb | context->opponent_bb;
 
     context->hash = get_context_hash(context);
+    context->reversible_plies = 0;
+    init_piece_scores(context);
 }
 
 void new_precomp_context(PlyContext *context, Piece piece, bool is_white) {
@@ -78,6 +108,7 @@ void new_precomp_context(PlyContext *context, Piece piece, bool is_white) {
     context->our_bb = GET_PIECE_BB_MASK(piece);
     context->opponent_bb = 0;
     context->piece_bb = context->our_bb;
+    init_piece_scores(context);
 }
 
 void remove_white_king_side_castling_rights(PlyContext *context) {
@@ -117,20 +148,26 @@ void flip_perspective(PlyContext *context) {
     context->opponent_bb = tmp;
 }
 
-// Updates the context such that the given move is played
-void update_context(PlyContext *context, Move move) {
-    UPDATE_HASH(context->hash, get_prev_move_hash(context->prev_move))
+// Updates the context such that the given move is played, without touching the move cache
+void update_context_no_prefetch(PlyContext *context, Move move) {
+    Move prev_move = context->prev_move;
+    UPDATE_HASH(context->hash, get_prev_move_hash(prev_move))
     UPDATE_HASH(context->hash, get_prev_move_hash(move))
     context->prev_move = move;
+    // Assume the move is reversible, until shown otherwise
+    context->reversible_plies++;
 
     bool has_promoted = false;
     // Handle special moves
     switch (move.special_move) {
         case EnPassant: {
-            uint8_t pawn_piece_id = 8 + move.to_x;
+            // The captured pawn is the one that just moved two squares
+            uint8_t pawn_piece_id = prev_move.piece_id;
             UPDATE_HASH(context->hash, get_piece_hash(context->opponent_pieces[pawn_piece_id], !context->is_white));
+            update_piece_scores(context, context->opponent_pieces[pawn_piece_id], !context->is_white, -1);
             context->opponent_bb ^= GET_PIECE_BB_MASK(context->opponent_pieces[pawn_piece_id]);
             context->opponent_pieces[pawn_piece_id].type = NullPiece;
+            context->reversible_plies = 0;
             break;
         }
 
@@ -156,14 +193,20 @@ void update_context(PlyContext *context, Move move) {
             if (context->is_white) {
                 context->white_can_castle_king_side = false;
                 UPDATE_HASH(context->hash, WHITE_CASTLE_KING_SIDE_HASH)
+                remove_white_queen_side_castling_rights(context);
             } else {
                 context->black_can_castle_king_side = false;
                 UPDATE_HASH(context->hash, BLACK_CASTLE_KING_SIDE_HASH)
+                remove_black_queen_side_castling_rights(context);
             }
-            // Move the king
+            context->reversible_plies = 0;
+            // Move the king and rook
+            update_piece_scores(context, context->our_pieces[4], context->is_white, -1);
+            update_piece_scores(context, context->our_pieces[7], context->is_white, -1);
             context->our_pieces[4].x = 6;
-            // Move the rook
             context->our_pieces[7].x = 5;
+            update_piece_scores(context, context->our_pieces[4], context->is_white, 1);
+            update_piece_scores(context, context->our_pieces[7], context->is_white, 1);
             // Update bitboards
             context->our_bb ^= context->is_white ?
                 WHITE_KING_SIDE_CASTLING_BB_XOR : BLACK_KING_SIDE_CASTLING_BB_XOR;
@@ -177,27 +220,40 @@ void update_context(PlyContext *context, Move move) {
             if (context->is_white) {
                 context->white_can_castle_queen_side = false;
                 UPDATE_HASH(context->hash, WHITE_CASTLE_QUEEN_SIDE_HASH)
+                remove_white_king_side_castling_rights(context);
             } else {
                 context->black_can_castle_queen_side = false;
                 UPDATE_HASH(context->hash, BLACK_CASTLE_QUEEN_SIDE_HASH)
+                remove_black_king_side_castling_rights(context);
             }
-            // Move the king
+            context->reversible_plies = 0;
+            // Move the king and rook
+            update_piece_scores(context, context->our_pieces[4], context->is_white, -1);
+            update_piece_scores(context, context->our_pieces[0], context->is_white, -1);
             context->our_pieces[4].x = 2;
-            // Move the rook
             context->our_pieces[0].x = 3;
+            update_piece_scores(context, context->our_pieces[4], context->is_white, 1);
+            update_piece_scores(context, context->our_pieces[0], context->is_white, 1);
             // Update bitboards
             context->our_bb ^= context->is_white ?
-                WHITE_QUEEN_SIDE_CASTLING_BB_XOR : WHITE_QUEEN_SIDE_CASTLING_BB_XOR;
+                WHITE_QUEEN_SIDE_CASTLING_BB_XOR : BLACK_QUEEN_SIDE_CASTLING_BB_XOR;
             context->piece_bb = context->our_bb | context->opponent_bb;
             // We don't want to update any positions at the end
             flip_perspective(context);
             return;
         case NullMove:
+            // Treat passing as irreversible, so that the search never finds repetitions across a null move
+            context->reversible_plies = 0;
             flip_perspective(context);
             return;
     }
 
+    // Pawn moves are irreversible
+    if (has_promoted || (context->our_pieces[move.piece_id].type == Pawn))
+        context->reversible_plies = 0;
+
     // Check if the King has moved, to remove castling rights
+    ContextHash castling_hash = context->hash;
     if (move.piece_id == 4) {
         if (context->is_white) {
             remove_white_king_side_castling_rights(context);
@@ -219,6 +275,9 @@ void update_context(PlyContext *context, Move move) {
             remove_black_queen_side_castling_rights(context);
         }
     }
+    // Losing castling rights is irreversible, and always changes the hash
+    if (context->hash != castling_hash)
+        context->reversible_plies = 0;
     context->our_bb ^= GET_PIECE_BB_MASK(context->our_pieces[move.piece_id]);
 
     // Update this piece's position
@@ -233,9 +292,11 @@ void update_context(PlyContext *context, Move move) {
         to_remove_from_hash = context->our_pieces[move.piece_id];
     }
     UPDATE_HASH(context->hash, get_piece_hash(to_remove_from_hash, context->is_white))
+    update_piece_scores(context, to_remove_from_hash, context->is_white, -1);
     context->our_pieces[move.piece_id].x = move.to_x;
     context->our_pieces[move.piece_id].y = move.to_y;
     UPDATE_HASH(context->hash, get_piece_hash(context->our_pieces[move.piece_id], context->is_white))
+    update_piece_scores(context, context->our_pieces[move.piece_id], context->is_white, 1);
     uint64_t piece_mask = GET_PIECE_BB_MASK(context->our_pieces[move.piece_id]);
     context->our_bb |= piece_mask;
 
@@ -249,8 +310,24 @@ void update_context(PlyContext *context, Move move) {
             // Search for the piece with matching coordinates
             if ((context->opponent_pieces[i].x == move.to_x) && (context->opponent_pieces[i].y == move.to_y)) {
                 UPDATE_HASH(context->hash, get_piece_hash(context->opponent_pieces[i], !context->is_white));
+                update_piece_scores(context, context->opponent_pieces[i], !context->is_white, -1);
                 context->opponent_pieces[i].type = NullPiece;
                 context->opponent_bb ^= piece_mask;
+                context->reversible_plies = 0;
+                // A captured rook can no longer castle
+                if (i == 7) {
+                    if (context->is_white) {
+                        remove_black_king_side_castling_rights(context);
+                    } else {
+                        remove_white_king_side_castling_rights(context);
+                    }
+                } else if (i == 0) {
+                    if (context->is_white) {
+                        remove_black_queen_side_castling_rights(context);
+                    } else {
+                        remove_white_queen_side_castling_rights(context);
+                    }
+                }
                 break;
             }
         }
@@ -259,6 +336,13 @@ void update_context(PlyContext *context, Move move) {
     flip_perspective(context);
 }
 
+// Updates the context such that the given move is played.
+// The new position is likely to be probed in the move cache soon, so start loading its bucket now.
+void update_context(PlyContext *context, Move move) {
+    update_context_no_prefetch(context, move);
+    prefetch_cache(context->hash);
+}
+
 void copy_context(PlyContext *from, PlyContext *to) {
     memcpy(to, from, sizeof(PlyContext));
     to->our_pieces = to->is_white ? to->white_pieces : to->black_pieces;
@@ -268,4 +352,9 @@ void copy_context(PlyContext *from, PlyContext *to) {
 void new_context_branch(PlyContext *original, PlyContext *branch, Move move) {
     copy_context(original, branch);
     update_context(branch, move);
+}
+
+void new_scratch_branch(PlyContext *original, PlyContext *branch, Move move) {
+    copy_context(original, branch);
+    update_context_no_prefetch(branch, move);
 }
\ No newline at end of file
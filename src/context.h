@@ -9,13 +9,24 @@ void new_context(PlyContext *context);
 // Create an empty board, except for the given piece, which is assigned to white (ID = 0)
 void new_precomp_context(PlyContext *context, Piece piece, bool is_white);
 
+// Recompute the piece-square scores, game phase and pawn hash of a context from its pieces.
+// Contexts whose pieces are set up directly must call this, since moves only update them incrementally.
+void init_piece_scores(PlyContext *context);
+
 // Updates the context such that the given move is played
 void update_context(PlyContext *context, Move move);
 
+// Updates the context such that the given move is played, without prefetching its move cache entry
+void update_context_no_prefetch(PlyContext *context, Move move);
+
 // Copy a PlyContext
 void copy_context(PlyContext *from, PlyContext *to);
 
 // Copy a PlyContext, such that the given move is played on branch
 void new_context_branch(PlyContext *original, PlyContext *branch, Move move);
 
+// Copy a PlyContext, such that the given move is played on branch, without prefetching its move cache entry.
+// Use this for throwaway branches that will never be searched, such as legality checks.
+void new_scratch_branch(PlyContext *original, PlyContext *branch, Move move);
+
 #endif
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "movegen.h"
 #include "precomp.h"
 #include "history.h"
+#include "position.h"
+#include "atomic.h"
 
 int32_t get_piece_base_value(Piece piece) {
     switch (piece.type) {
@@ -23,38 +25,193 @@ int32_t get_piece_base_value(Piece piece) {
     }
 }
 
-int32_t get_pawn_y_bonus(uint8_t y, bool is_white) {
-    return PAWN_Y_VALUE_BONUS * (is_white ? y : 7 - y);
+int32_t get_piece_type_value(PieceType type) {
+    return get_piece_base_value((Piece){type, 0, 0});
 }
 
-int32_t evaluate_material(PlyContext *context) {
-    int32_t our_total = 0, enemy_total = 0;
-    for (int i = 0; i < 16; i++) {
-        our_total += get_piece_base_value(context->our_pieces[i]);
-        our_total += PIECE_POSSIBLE_MOVES_BONUS_MULTIPLIER * get_piece_possible_n_moves(context->our_pieces[i], context->is_white);
-        if (context->our_pieces[i].type == Pawn) {
-            our_total += get_pawn_y_bonus(context->our_pieces[i].y, context->is_white);
+int32_t MIDDLEGAME_PIECE_SQUARE_TABLE[2][7][64];
+int32_t ENDGAME_PIECE_SQUARE_TABLE[2][7][64];
+
+// Both files next to each file
+uint64_t ADJACENT_FILES_BB_TABLE[8];
+// The squares ahead of a pawn on its file, indexed by [is_white][square]
+uint64_t PAWN_FRONT_SPAN_BB_TABLE[2][64];
+// The squares ahead of a pawn on its file and the adjacent files. A pawn is passed if no enemy pawn is on them.
+uint64_t PASSED_PAWN_SPAN_BB_TABLE[2][64];
+// The squares on the adjacent files, level with or behind a pawn, where friendly pawns could still defend its advance
+uint64_t PAWN_SUPPORT_BB_TABLE[2][64];
+
+// Knights and bishops count 1, rooks 2, and queens 4
+const uint8_t GAME_PHASE_WEIGHTS[7] = {0, 0, 0, 1, 1, 2, 4};
+
+// In both phases, pieces are worth their base value, plus a bonus for each move they could make from their square on
+// an empty board. Pawns also gain value as they advance. This also precomputes the masks used to find pawn weaknesses.
+void init_eval(void) {
+    for (int is_white = 0; is_white < 2; is_white++) {
+        for (int type = King; type <= Queen; type++) {
+            for (int pos = 0; pos < 64; pos++) {
+                Piece piece = {type, pos % 8, pos / 8};
+                int32_t base_value = get_piece_base_value(piece);
+                int32_t n_moves = get_piece_possible_n_moves(piece, is_white);
+                int32_t advance = is_white ? piece.y : 7 - piece.y;
+
+                MIDDLEGAME_PIECE_SQUARE_TABLE[is_white][type][pos] = base_value
+                    + PIECE_POSSIBLE_MOVES_BONUS_MULTIPLIER * n_moves
+                    + (type == Pawn ? PAWN_Y_VALUE_BONUS * advance : 0);
+                ENDGAME_PIECE_SQUARE_TABLE[is_white][type][pos] = base_value
+                    + (type == King ? ENDGAME_KING_POSSIBLE_MOVES_BONUS_MULTIPLIER : PIECE_POSSIBLE_MOVES_BONUS_MULTIPLIER) * n_moves
+                    + (type == Pawn ? ENDGAME_PAWN_Y_VALUE_BONUS * advance : 0);
+            }
+        }
+    }
+
+    for (int x = 0; x < 8; x++) {
+        ADJACENT_FILES_BB_TABLE[x] = 0;
+        for (int y = 0; y < 8; y++) {
+            if (x > 0)
+                ADJACENT_FILES_BB_TABLE[x] |= GET_POS_BB_MASK((y << 3) + x - 1);
+            if (x < 7)
+                ADJACENT_FILES_BB_TABLE[x] |= GET_POS_BB_MASK((y << 3) + x + 1);
+        }
+    }
+    for (int is_white = 0; is_white < 2; is_white++) {
+        for (int pos = 0; pos < 64; pos++) {
+            int x = pos % 8, y = pos / 8;
+            PAWN_FRONT_SPAN_BB_TABLE[is_white][pos] = 0;
+            PASSED_PAWN_SPAN_BB_TABLE[is_white][pos] = 0;
+            PAWN_SUPPORT_BB_TABLE[is_white][pos] = 0;
+            for (int other_y = 0; other_y < 8; other_y++) {
+                uint64_t rank = (uint64_t)0xFF << (other_y << 3);
+                if (is_white ? (other_y > y) : (other_y < y)) {
+                    PAWN_FRONT_SPAN_BB_TABLE[is_white][pos] |= GET_POS_BB_MASK((other_y << 3) + x);
+                    PASSED_PAWN_SPAN_BB_TABLE[is_white][pos] |= GET_POS_BB_MASK((other_y << 3) + x)
+                        | (rank & ADJACENT_FILES_BB_TABLE[x]);
+                } else {
+                    PAWN_SUPPORT_BB_TABLE[is_white][pos] |= rank & ADJACENT_FILES_BB_TABLE[x];
+                }
+            }
+        }
+    }
+}
+
+// Scores one side's pawn structure, in the same units as the piece-square tables
+void evaluate_pawn_structure(
+    uint64_t our_pawns, uint64_t enemy_pawns, bool is_white, int32_t *middlegame, int32_t *endgame
+) {
+    *middlegame = 0;
+    *endgame = 0;
+    uint64_t remaining = our_pawns;
+    while (remaining != 0) {
+        int pos = __builtin_ctzll(remaining);
+        remaining &= remaining - 1;
+        int advance = is_white ? (pos >> 3) : 7 - (pos >> 3);
+
+        if ((our_pawns & ADJACENT_FILES_BB_TABLE[pos & 7]) == 0) {
+            *middlegame -= ISOLATED_PAWN_PENALTY;
+            *endgame -= ENDGAME_ISOLATED_PAWN_PENALTY;
+        } else if ((our_pawns & PAWN_SUPPORT_BB_TABLE[is_white][pos]) == 0) {
+            // A pawn is backward if no friendly pawn can defend it as it advances, and an enemy pawn guards the square
+            // in front of it. The guards stand where a pawn on that square would attack.
+            int stop = is_white ? pos + 8 : pos - 8;
+            uint64_t stop_guards = is_white ?
+                WHITE_PAWN_POSSIBLE_ATTACK_BB_TABLE[stop] : BLACK_PAWN_POSSIBLE_ATTACK_BB_TABLE[stop];
+            if ((enemy_pawns & stop_guards) != 0) {
+                *middlegame -= BACKWARD_PAWN_PENALTY;
+                *endgame -= ENDGAME_BACKWARD_PAWN_PENALTY;
+            }
+        }
+
+        // Only the front pawn of a file can be passed, and the pawns behind it are doubled
+        if ((our_pawns & PAWN_FRONT_SPAN_BB_TABLE[is_white][pos]) != 0) {
+            *middlegame -= DOUBLED_PAWN_PENALTY;
+            *endgame -= ENDGAME_DOUBLED_PAWN_PENALTY;
+        } else if ((enemy_pawns & PASSED_PAWN_SPAN_BB_TABLE[is_white][pos]) == 0) {
+            *middlegame += PASSED_PAWN_Y_VALUE_BONUS * advance;
+            *endgame += ENDGAME_PASSED_PAWN_Y_VALUE_BONUS * advance;
         }
+    }
+}
+
+// Pawn structure scores are cached by the pawn hash, since few pawn moves are made in a search.
+// Search threads share the cache without locks, so each key is stored XORed with its data,
+// and entries torn by concurrent writes fail to match.
+typedef struct {
+    uint64_t key;
+    // The middlegame scores of black and white, then their endgame scores, as 16-bit fields
+    uint64_t data;
+} PawnCacheEntry;
 
-        enemy_total += get_piece_base_value(context->opponent_pieces[i]);
-        enemy_total += PIECE_POSSIBLE_MOVES_BONUS_MULTIPLIER * get_piece_possible_n_moves(context->opponent_pieces[i], !context->is_white);
-        if (context->opponent_pieces[i].type == Pawn) {
-            enemy_total += get_pawn_y_bonus(context->opponent_pieces[i].y, !context->is_white);
+PawnCacheEntry pawn_cache[PAWN_CACHE_ENTRIES];
+
+// Sets the pawn structure scores of both sides, indexed by is_white
+void get_pawn_scores(PlyContext *context, int32_t middlegame[2], int32_t endgame[2]) {
+    PawnCacheEntry *entry = &pawn_cache[context->pawn_hash & (PAWN_CACHE_ENTRIES - 1)];
+    uint64_t data = ATOMIC_LOAD(&entry->data);
+    if ((ATOMIC_LOAD(&entry->key) ^ data) != context->pawn_hash) {
+        uint64_t pawns[2] = {0, 0};
+        for (int i = 0; i < 16; i++) {
+            if (context->black_pieces[i].type == Pawn)
+                pawns[0] |= GET_PIECE_BB_MASK(context->black_pieces[i]);
+            if (context->white_pieces[i].type == Pawn)
+                pawns[1] |= GET_PIECE_BB_MASK(context->white_pieces[i]);
+        }
+        data = 0;
+        for (int is_white = 0; is_white < 2; is_white++) {
+            int32_t side_middlegame, side_endgame;
+            evaluate_pawn_structure(pawns[is_white], pawns[!is_white], is_white, &side_middlegame, &side_endgame);
+            data |= (uint64_t)(uint16_t)side_middlegame << (16 * is_white);
+            data |= (uint64_t)(uint16_t)side_endgame << (16 * (2 + is_white));
         }
+        ATOMIC_STORE(&entry->data, data);
+        ATOMIC_STORE(&entry->key, context->pawn_hash ^ data);
+    }
+    for (int is_white = 0; is_white < 2; is_white++) {
+        middlegame[is_white] = (int16_t)(data >> (16 * is_white));
+        endgame[is_white] = (int16_t)(data >> (16 * (2 + is_white)));
+    }
+}
+
+// The total of a side's piece-square and pawn structure scores, tapered from the middlegame to the endgame as pieces
+// are traded
+int32_t get_tapered_score(PlyContext *context, bool is_white, int32_t pawn_middlegame[2], int32_t pawn_endgame[2]) {
+    int32_t phase = context->game_phase < MAX_GAME_PHASE ? context->game_phase : MAX_GAME_PHASE;
+    return ((context->middlegame_scores[is_white] + pawn_middlegame[is_white]) * phase
+        + (context->endgame_scores[is_white] + pawn_endgame[is_white]) * (MAX_GAME_PHASE - phase)) / MAX_GAME_PHASE;
+}
+
+int32_t evaluate_material(PlyContext *context, int32_t *our_material) {
+    int32_t pawn_middlegame[2], pawn_endgame[2];
+    get_pawn_scores(context, pawn_middlegame, pawn_endgame);
+    int32_t our_total = get_tapered_score(context, context->is_white, pawn_middlegame, pawn_endgame);
+    int32_t enemy_total = get_tapered_score(context, !context->is_white, pawn_middlegame, pawn_endgame);
+    if (our_material != NULL) {
+        *our_material = our_total;
+    }
+    int32_t score = (10000 * (our_total - enemy_total)) / our_total;
+    if (score > MAX_EVAL_VALUE)
+        return MAX_EVAL_VALUE;
+    if (score < -MAX_EVAL_VALUE)
+        return -MAX_EVAL_VALUE;
+    return score;
+}
+
+int32_t evaluate_leaf(PlyContext *context, bool in_check, int32_t *our_material) {
+    if ((in_check || (__builtin_popcountll(context->our_bb) <= LEAF_STALEMATE_MAX_PIECES)) && !has_legal_move(context)) {
+        return in_check ? LOSS_VALUE : DRAW_VALUE;
     }
-    return (10000 * (our_total - enemy_total)) / our_total;
+    return evaluate_material(context, our_material);
 }
 
 int32_t evaluate_with(PlyContext *context, MoveList legal_moves) {
     if (legal_moves.n_moves == 0) {
         return is_in_check(context) ? LOSS_VALUE : DRAW_VALUE;
     }
-    return evaluate_material(context);
+    return evaluate_material(context, NULL);
 }
 
 int32_t evaluate(PlyContext *context) {
     if (!has_legal_move(context)) {
         return is_in_check(context) ? LOSS_VALUE : DRAW_VALUE;
     }
-    return evaluate_material(context);
+    return evaluate_material(context, NULL);
 }
\ No newline at end of file
@@ -3,6 +3,34 @@
 
 #include "types.h"
 
+// The game phase of the starting position
+#define MAX_GAME_PHASE 24
+
+// Piece-square values, including the base value of the piece, indexed by [is_white][piece type][square]
+extern int32_t MIDDLEGAME_PIECE_SQUARE_TABLE[2][7][64];
+extern int32_t ENDGAME_PIECE_SQUARE_TABLE[2][7][64];
+
+// How much each piece type contributes to the game phase
+extern const uint8_t GAME_PHASE_WEIGHTS[7];
+
+// Precompute the piece-square tables. This requires the precomputed move tables.
+void init_eval(void);
+
+// The base value of a piece type
+int32_t get_piece_type_value(PieceType type);
+
+// Evaluates material, piece placement and pawn structure only, without checking for mate or stalemate.
+// This blends the context's middlegame and endgame scores by its game phase. Pawn structure scores are cached by the
+// context's pawn hash, so pieces are only looked at when a pawn structure is first seen.
+// Evaluations are relative to our material, so if our_material is not NULL, it is set to our material total.
+// A change of v in raw piece value changes the evaluation by about (10000 * v) / our_material.
+int32_t evaluate_material(PlyContext *context, int32_t *our_material);
+
+// Evaluates a leaf, where legal moves are not generated. Mate and stalemate are only checked for when in check,
+// or when we have few enough pieces that we could plausibly run out of moves, since that check costs more than the
+// rest of the evaluation. Otherwise, this is the same as evaluate_material.
+int32_t evaluate_leaf(PlyContext *context, bool in_check, int32_t *our_material);
+
 int32_t evaluate_with(PlyContext *context, MoveList legal_moves);
 
 int32_t evaluate(PlyContext *context);
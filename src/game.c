@@ -2,6 +2,9 @@
 
 #include "game.h"
 #include "types.h"
+#include "search.h"
+#include "context.h"
+#include "constants.h"
 
 char get_piece_type_char(PieceType type, bool is_white) {
     uint8_t shift = is_white ? 0 : 32;
@@ -67,4 +70,128 @@ void print_history(GameHistory *history) {
         printf(" %s", history->moves[i]);
     }
     printf("\n\n");
-}
\ No newline at end of file
+}
+
+void get_move_code(PlyContext *context, Move move, char code[6]) {
+    Piece piece = context->our_pieces[move.piece_id];
+    code[0] = piece.x + 'a';
+    code[1] = piece.y + '1';
+    code[2] = move.to_x + 'a';
+    code[3] = move.to_y + '1';
+    switch (move.special_move) {
+        case PromoteKnight:
+            code[4] = 'n';
+            code[5] = '\0';
+            break;
+        case PromoteBishop:
+            code[4] = 'b';
+            code[5] = '\0';
+            break;
+        case PromoteRook:
+            code[4] = 'r';
+            code[5] = '\0';
+            break;
+        case PromoteQueen:
+            code[4] = 'q';
+            code[5] = '\0';
+            break;
+        default:
+            code[4] = '\0';
+            break;
+    }
+}
+
+void print_moves(PlyContext *context, Move *moves, uint32_t n_moves) {
+    PlyContext position;
+    copy_context(context, &position);
+    char code[6];
+    for (uint32_t i = 0; i < n_moves; i++) {
+        get_move_code(&position, moves[i], code);
+        printf("%s%s", i == 0 ? "" : " ", code);
+        update_context_no_prefetch(&position, moves[i]);
+    }
+}
+
+// Percentage of the part in the whole, or 0 if the whole is empty
+double get_percentage(uint64_t part, uint64_t whole) {
+    return whole == 0 ? 0 : (100.0 * part) / whole;
+}
+
+void print_search_stats(SearchStats *stats) {
+    printf("Search statistics:\n");
+    printf("\tNodes: %llu (%llu quiescence)\n", (unsigned long long)stats->nodes, (unsigned long long)stats->qnodes);
+    uint64_t nps = stats->time_us == 0 ? 0 : (stats->nodes * 1000000) / stats->time_us;
+    printf("\tTime: %.3f s (%llu nodes/s)\n", stats->time_us / 1000000.0, (unsigned long long)nps);
+    printf(
+        "\tMove cache: %llu probes, %.1f%% hits, %llu collisions, %.1f%% full\n",
+        (unsigned long long)stats->cache_probes, get_percentage(stats->cache_hits, stats->cache_probes),
+        (unsigned long long)stats->cache_collisions, stats->cache_fill_permille / 10.0
+    );
+    printf(
+        "\tCutoffs: %llu, %.1f%% on the first move\n",
+        (unsigned long long)stats->cutoffs, get_percentage(stats->first_move_cutoffs, stats->cutoffs)
+    );
+    if (stats->profiled) {
+        uint64_t other_time_us = stats->time_us - stats->movegen_time_us - stats->eval_time_us;
+        printf(
+            "\tTime split (main thread): %.1f%% move generation, %.1f%% evaluation, %.1f%% search\n",
+            get_percentage(stats->movegen_time_us, stats->time_us), get_percentage(stats->eval_time_us, stats->time_us),
+            get_percentage(other_time_us, stats->time_us)
+        );
+    } else {
+        printf("\tTime split: not measured (enable with 'stats on')\n");
+    }
+
+    // The effective branching factor is the growth in nodes from one iteration to the next
+    printf("\tIterations (main thread):\n\t\tDepth\tScore\tNodes\t\tEBF\n");
+    for (uint32_t i = 0; i < stats->n_iterations; i++) {
+        printf(
+            "\t\t%d\t%d\t%-12llu\t", stats->iteration_depths[i], stats->iteration_scores[i],
+            (unsigned long long)stats->iteration_nodes[i]
+        );
+        if ((i == 0) || (stats->iteration_nodes[i - 1] == 0)) {
+            printf("-\n");
+        } else {
+            printf("%.2f\n", (double)stats->iteration_nodes[i] / stats->iteration_nodes[i - 1]);
+        }
+    }
+    printf("\n");
+}
+
+// Mate scores count plies from the root, so display them in moves
+void print_score(int32_t score) {
+    if (score >= MATE_SCORE_THRESHOLD) {
+        printf("mate in %d", (WIN_VALUE - score + 1) / 2);
+    } else if (score <= -MATE_SCORE_THRESHOLD) {
+        printf("mated in %d", (score - LOSS_VALUE + 1) / 2);
+    } else {
+        printf("%+d", score);
+    }
+}
+
+void print_search_status(PlyContext *context, SearchStatus *status) {
+    printf("\n%s for %.1f s, %llu nodes", status->pondering ? "Pondering" : "Thinking",
+        status->time_ms / 1000.0, (unsigned long long)status->nodes);
+    if (status->depth == 0) {
+        printf(", no iterations completed.\n");
+        return;
+    }
+    printf(", depth %d (", status->depth);
+    print_score(status->line.score);
+    printf("): ");
+    print_moves(context, status->line.pv, status->line.pv_length);
+    printf("\n");
+    fflush(stdout);
+}
+
+void print_search_lines(PlyContext *context, SearchStats *stats) {
+    for (uint32_t i = 0; i < stats->n_lines; i++) {
+        SearchLine *line = &stats->lines[i];
+        printf("%u. (", i + 1);
+        print_score(line->score);
+        printf(") ");
+        print_moves(context, line->pv, line->pv_length);
+        printf("\n");
+    }
+    printf("\n");
+}
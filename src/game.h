@@ -2,9 +2,24 @@
 #define GAME_H
 
 #include "types.h"
+#include "search.h"
 
 void print_board(PlyContext *context, bool display_as_white);
 
 void print_history(GameHistory *history);
 
+// Write a move in algebraic coordinates (e.g., e2e4, g7g8q)
+void get_move_code(PlyContext *context, Move move, char code[6]);
+
+// Print a sequence of moves starting from the given position, in algebraic coordinates
+void print_moves(PlyContext *context, Move *moves, uint32_t n_moves);
+
+void print_search_stats(SearchStats *stats);
+
+// Print the progress of a background search from the given position
+void print_search_status(PlyContext *context, SearchStatus *status);
+
+// Print the score and moves of each line found by a search from the given position
+void print_search_lines(PlyContext *context, SearchStats *stats);
+
 #endif
\ No newline at end of file
@@ -1,26 +1,19 @@
-#include <time.h>
-#include <stdlib.h>
-
 #include "hash.h"
 
-const ContextHash NULL_HASH = {.alpha = 0, .beta = 0};
+// The seed for the hash keys. Changing it invalidates saved move caches.
+#define ZOBRIST_SEED 0x9E3779B97F4A7C15
 
-ContextHash rand_hash(void) {
-    return (ContextHash){
-        .alpha = (int64_t)rand() + ((int64_t)rand() << 32),
-        .beta = (int64_t)rand() + ((int64_t)rand() << 32)
-    };
-}
+const ContextHash NULL_HASH = 0;
 
-ContextHash xor_hash(ContextHash a, ContextHash b) {
-    return (ContextHash){
-        .alpha = a.alpha ^ b.alpha,
-        .beta = a.beta ^ b.beta
-    };
-}
+// SplitMix64, which produces well-distributed 64-bit keys from a fixed seed.
+// Unlike rand(), its output is identical across platforms and C libraries.
+static uint64_t zobrist_state;
 
-bool is_hash_eq(ContextHash a, ContextHash b) {
-    return (a.alpha == b.alpha) && (a.beta == b.beta);
+ContextHash rand_hash(void) {
+    uint64_t z = (zobrist_state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
 }
 
 ContextHash PAWN_FIRST_MOVE_TABLE[8];
@@ -65,7 +58,8 @@ ContextHash get_context_hash(PlyContext *context) {
 }
 
 void init_hashing(void) {
-    srand(time(NULL));
+    // Use a fixed seed, so that hashes are stable between runs and saved move caches remain valid
+    zobrist_state = ZOBRIST_SEED;
     for (int i = 0; i < 8; i++) {
         PAWN_FIRST_MOVE_TABLE[i] = rand_hash();
     }
@@ -91,14 +85,14 @@ void init_hashing(void) {
     UPDATE_HASH(WHITE_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){Rook, 5, 0}, true))
 
     BLACK_CASTLE_QUEEN_SIDE_HASH = BLACK_CAN_CASTLE_QUEEN_SIDE_HASH;
-    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){King, 4, 7}, true))
-    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){King, 2, 7}, true))
-    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){Rook, 0, 7}, true))
-    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){Rook, 3, 7}, true))
+    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){King, 4, 7}, false))
+    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){King, 2, 7}, false))
+    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){Rook, 0, 7}, false))
+    UPDATE_HASH(BLACK_CASTLE_QUEEN_SIDE_HASH, get_piece_hash((Piece){Rook, 3, 7}, false))
 
     BLACK_CASTLE_KING_SIDE_HASH = BLACK_CAN_CASTLE_KING_SIDE_HASH;
-    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){King, 4, 7}, true))
-    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){King, 6, 7}, true))
-    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){Rook, 7, 7}, true))
-    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){Rook, 5, 7}, true))
+    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){King, 4, 7}, false))
+    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){King, 6, 7}, false))
+    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){Rook, 7, 7}, false))
+    UPDATE_HASH(BLACK_CASTLE_KING_SIDE_HASH, get_piece_hash((Piece){Rook, 5, 7}, false))
 }
\ No newline at end of file
@@ -7,70 +7,54 @@
 #include "hash.h"
 #include "context.h"
 
-void new_state_repetitions(StateRepetitions *repetition) {
-    repetition->hashes = calloc(MAX_GAME_PLY, sizeof(ContextHash));
-    repetition->entries = calloc(MAX_GAME_PLY, sizeof(uint8_t));
-    repetition->n_entries = 0;
+// Room for a full game, and a full search on top of it
+#define STATE_REPETITIONS_CAPACITY (MAX_GAME_PLY + MAX_SEARCH_PLY)
+
+void new_state_repetitions(StateRepetitions *repetitions) {
+    repetitions->hashes = malloc(STATE_REPETITIONS_CAPACITY * sizeof(ContextHash));
+    repetitions->length = 0;
 }
 
-void free_state_repetitions(StateRepetitions *repetitions) {
-    free(repetitions->hashes);
-    free(repetitions->entries);
+void copy_state_repetitions(StateRepetitions *from, StateRepetitions *to) {
+    new_state_repetitions(to);
+    memcpy(to->hashes, from->hashes, from->length * sizeof(ContextHash));
+    to->length = from->length;
 }
 
-void append_state_repetition(StateRepetitions *repetition, ContextHash hash) {
-    for (uint32_t i = 0; i < repetition->n_entries; i++) {
-        if (is_hash_eq(repetition->hashes[i], hash)) {
-            repetition->entries[i]++;
-            return;
-        }
-    }
-    repetition->hashes[repetition->n_entries] = hash;
-    repetition->entries[repetition->n_entries] = 1;
-    repetition->n_entries++;
+void free_state_repetitions(StateRepetitions *repetitions) {
+    free(repetitions->hashes);
 }
 
-void remove_state_repetition(StateRepetitions *repetition, ContextHash hash) {
-    for (uint32_t i = 0; i < repetition->n_entries; i++) {
-        if (is_hash_eq(repetition->hashes[i], hash)) {
-            repetition->entries[i]--;
-            if (repetition->entries[i] == 0) {
-                repetition->n_entries--;
-                repetition->hashes[i] = repetition->hashes[repetition->n_entries];
-                repetition->entries[i] = repetition->entries[repetition->n_entries];
-            }
-            return;
-        }
-    }
+void push_state_repetition(StateRepetitions *repetitions, ContextHash hash) {
+    repetitions->hashes[repetitions->length++] = hash;
 }
 
-void _state_repetition_branch(StateRepetitions *original, StateRepetitions *branch, ContextHash hash) {
-    new_state_repetitions(branch);
-    memcpy(branch->hashes, original->hashes, MAX_GAME_PLY * sizeof(ContextHash));
-    memcpy(branch->entries, original->entries, MAX_GAME_PLY * sizeof(uint8_t));
-    branch->n_entries = original->n_entries;
-    append_state_repetition(branch, hash);
+void pop_state_repetition(StateRepetitions *repetitions) {
+    repetitions->length--;
 }
 
-uint8_t n_state_repetitions(StateRepetitions *repetitions, ContextHash hash) {
-    for (uint32_t i = 0; i < repetitions->n_entries; i++) {
-        if (is_hash_eq(repetitions->hashes[i], hash)) {
-            return repetitions->entries[i];
+uint8_t n_state_repetitions(StateRepetitions *repetitions, PlyContext *context) {
+    // Positions can only repeat with the same player to move, and never across an irreversible move
+    uint32_t lookback = context->reversible_plies < repetitions->length ?
+        context->reversible_plies : repetitions->length;
+    uint8_t n_repetitions = 1;
+    for (uint32_t i = 2; i <= lookback; i += 2) {
+        if (repetitions->hashes[repetitions->length - i] == context->hash) {
+            n_repetitions++;
         }
     }
-    return 0;
+    return n_repetitions;
 }
 
 // TOOD: More robust draw detection
-bool is_repetition_draw(StateRepetitions *repetitions, ContextHash hash) {
-    return n_state_repetitions(repetitions, hash) >= N_REPETITIONS_DRAW;
+bool is_repetition_draw(StateRepetitions *repetitions, PlyContext *context) {
+    return n_state_repetitions(repetitions, context) >= N_REPETITIONS_DRAW;
 }
 
-bool will_be_repetition_draw(StateRepetitions *repetitions, ContextHash hash) {
-    return n_state_repetitions(repetitions, hash) >= N_REPETITIONS_DRAW - 1;
+bool will_be_repetition_draw(StateRepetitions *repetitions, PlyContext *context) {
+    return n_state_repetitions(repetitions, context) >= N_REPETITIONS_DRAW - 1;
 }
 
-
 void new_history(GameHistory *history) {
     history->contexts = calloc(MAX_GAME_PLY, sizeof(PlyContext));
     history->moves = calloc(MAX_GAME_PLY, sizeof(char) * 6);
@@ -88,16 +72,17 @@ void append_history(GameHistory *history, PlyContext *context, char move[6]) {
     copy_context(context, &history->contexts[history->length]);
     strcpy(history->moves[history->length], move);
     history->length++;
-    append_state_repetition(&history->repetitions, context->hash);
+    push_state_repetition(&history->repetitions, context->hash);
 }
 
 void pop_history(GameHistory *history, PlyContext *context, char move[6]) {
     history->length--;
     copy_context(&history->contexts[history->length], context);
     strcpy(move, history->moves[history->length]);
-    remove_state_repetition(&history->repetitions, context->hash);
+    pop_state_repetition(&history->repetitions);
 }
 
 void clear_history(GameHistory *history) {
     history->length = 0;
+    history->repetitions.length = 0;
 }
\ No newline at end of file
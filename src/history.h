@@ -3,11 +3,15 @@
 
 #include "types.h"
 
+void new_state_repetitions(StateRepetitions *repetitions);
+void copy_state_repetitions(StateRepetitions *from, StateRepetitions *to);
 void free_state_repetitions(StateRepetitions *repetitions);
-void _state_repetition_branch(StateRepetitions *original, StateRepetitions *branch, ContextHash hash);
-uint8_t n_state_repetitions(StateRepetitions *repetitions, ContextHash hash);
-bool is_repetition_draw(StateRepetitions *repetitions, ContextHash hash);
-bool will_be_repetition_draw(StateRepetitions *repetitions, ContextHash hash);
+void push_state_repetition(StateRepetitions *repetitions, ContextHash hash);
+void pop_state_repetition(StateRepetitions *repetitions);
+// The number of times the context's position has occurred, including itself
+uint8_t n_state_repetitions(StateRepetitions *repetitions, PlyContext *context);
+bool is_repetition_draw(StateRepetitions *repetitions, PlyContext *context);
+bool will_be_repetition_draw(StateRepetitions *repetitions, PlyContext *context);
 
 void new_history(GameHistory *history);
 void free_history(GameHistory *history);
@@ -2,6 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/select.h>
+#include <unistd.h>
+#define CAN_POLL_INPUT
+#endif
+
 #include "context.h"
 #include "game.h"
 #include "types.h"
@@ -12,10 +18,21 @@
 #include "precomp.h"
 #include "hash.h"
 #include "history.h"
+#include "cache.h"
+#include "timer.h"
+#include "mate.h"
+#include "mcts.h"
+#include "bitbase.h"
+#include "book.h"
 
 void init(void) {
     init_precomp();
+    init_eval();
     init_hashing();
+    init_cache();
+    init_search();
+    init_bitbases();
+    open_book(BOOK_FILE);
 }
 
 void clear_input_buffer(void) {
@@ -23,6 +40,166 @@ void clear_input_buffer(void) {
     while ((c = getchar()) != '\n' && c != EOF);
 }
 
+// How often to check for user input while the computer is thinking, in milliseconds
+#define INPUT_POLL_INTERVAL_MS 5
+
+#ifdef CAN_POLL_INPUT
+// Input is read from stdin with read() into this buffer, rather than through stdio.
+// Lines that stdio read ahead would be invisible to select(), so polling could miss them.
+#define INPUT_BUFFER_SIZE 4096
+char input_buffer[INPUT_BUFFER_SIZE];
+size_t input_buffer_length = 0;
+bool input_ended = false;
+
+typedef enum {
+    InputLine,
+    // No full line has been entered yet
+    InputPending,
+    InputEnded,
+} InputStatus;
+
+// Takes the first line out of the input buffer, if it holds a full one
+bool take_buffered_line(char input[256]) {
+    char *newline = memchr(input_buffer, '\n', input_buffer_length);
+    size_t line_length = newline ? (size_t)(newline - input_buffer) : input_buffer_length;
+    // The last line of the input may have no newline, and overlong lines are cut short
+    if (!newline && !(input_ended && (input_buffer_length > 0)) && (input_buffer_length < INPUT_BUFFER_SIZE))
+        return false;
+
+    size_t copied = line_length < 255 ? line_length : 255;
+    memcpy(input, input_buffer, copied);
+    input[copied] = 0;
+    size_t consumed = newline ? line_length + 1 : line_length;
+    input_buffer_length -= consumed;
+    memmove(input_buffer, input_buffer + consumed, input_buffer_length);
+    return true;
+}
+
+// Reads the next line of input, waiting at most timeout_ms for it, or until it arrives if timeout_ms is negative
+InputStatus poll_input_line(char input[256], int32_t timeout_ms) {
+    for (;;) {
+        if (take_buffered_line(input))
+            return InputLine;
+        if (input_ended)
+            return InputEnded;
+        if (timeout_ms >= 0) {
+            fd_set input_fds;
+            FD_ZERO(&input_fds);
+            FD_SET(STDIN_FILENO, &input_fds);
+            struct timeval timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+            if (select(STDIN_FILENO + 1, &input_fds, NULL, NULL, &timeout) <= 0)
+                return InputPending;
+            // Only wait once, but keep reading while more input is ready
+            timeout_ms = 0;
+        }
+        ssize_t n_read = read(
+            STDIN_FILENO, input_buffer + input_buffer_length, INPUT_BUFFER_SIZE - input_buffer_length
+        );
+        if (n_read <= 0) {
+            input_ended = true;
+        } else {
+            input_buffer_length += n_read;
+        }
+    }
+}
+#endif
+
+// Reads a line of input, without its newline. Returns false at the end of the input.
+bool read_input_line(char input[256]) {
+    // Prompts are printed without newlines, so make sure they are shown before waiting
+    fflush(stdout);
+#ifdef CAN_POLL_INPUT
+    return poll_input_line(input, -1) == InputLine;
+#else
+    if (!fgets(input, 256, stdin))
+        return false;
+    input[strcspn(input, "\n")] = 0;
+    return true;
+#endif
+}
+// The most commands that can be entered while the computer is thinking, to be handled once it has moved
+#define MAX_PENDING_INPUTS 16
+
+// Input received while the computer was thinking, in the order it was entered
+typedef struct {
+    char inputs[MAX_PENDING_INPUTS][256];
+    uint32_t length;
+} PendingInputs;
+
+// Queues a command to be handled once the computer has moved, or turns it away if the queue is full
+void push_pending_input(PendingInputs *pending, char *input) {
+    if (pending->length == MAX_PENDING_INPUTS) {
+        printf("The computer is busy, ignoring '%s'.\n", input);
+        fflush(stdout);
+        return;
+    }
+    strcpy(pending->inputs[pending->length++], input);
+}
+
+// Takes the oldest queued command, returning false if there is none
+bool pop_pending_input(PendingInputs *pending, char input[256]) {
+    if (pending->length == 0)
+        return false;
+    strcpy(input, pending->inputs[0]);
+    pending->length--;
+    memmove(pending->inputs[0], pending->inputs[1], sizeof(pending->inputs[0]) * pending->length);
+    return true;
+}
+
+// Handles a line of input entered while the computer is thinking. Returns true if it stopped the search.
+bool handle_search_input(PlyContext *context, PendingInputs *pending, char *input) {
+    if (strcmp(input, "stop") == 0) {
+        stop_search();
+        return true;
+    }
+    if (strcmp(input, "status") == 0) {
+        SearchStatus status = get_search_status();
+        print_search_status(context, &status);
+    } else {
+        push_pending_input(pending, input);
+    }
+    return false;
+}
+
+// Whether a search with these limits ends by itself, rather than only when it is stopped
+bool is_search_limited(SearchLimits *limits) {
+    return (limits->depth != 0) || (limits->move_time != 0) || (limits->clock_time != 0) || (limits->nodes != 0);
+}
+
+// Waits for the background search to finish, while handling the `stop` and `status` commands.
+// Any other input is queued, to be handled once the search is over.
+// A search without limits could only end when stopped, so it is also stopped at the end of the input.
+BestMove await_search(PlyContext *context, PendingInputs *pending, bool is_limited) {
+    char input[256];
+#ifdef CAN_POLL_INPUT
+    while (!is_search_finished()) {
+        InputStatus status = poll_input_line(input, INPUT_POLL_INTERVAL_MS);
+        if (status == InputPending)
+            continue;
+        // Stop reading at the end of the input, and leave it to be reported after the search
+        if (status == InputEnded) {
+            if (!is_limited)
+                stop_search();
+            break;
+        }
+        if (handle_search_input(context, pending, input))
+            break;
+    }
+#else
+    // Without polling, reading input blocks until a line is entered, so it is only read when the search needs to be
+    // stopped to end
+    while (!is_limited) {
+        if (!read_input_line(input)) {
+            stop_search();
+            break;
+        }
+        if (handle_search_input(context, pending, input))
+            break;
+    }
+#endif
+    return wait_for_search();
+}
+
 int main(int argc, char **argv) {
     init();
 
@@ -36,8 +213,26 @@ int main(int argc, char **argv) {
     MoveList legal_moves = { .moves = NULL, .n_moves = 0 };
     char (*legal_move_codes)[6] = malloc(sizeof(char) * 6 * MAX_GAME_PLY);
 
+    SearchLimits limits = new_search_limits();
+    // Time left on each side's clock, which only runs while the computer is thinking
+    uint64_t white_clock_time = 0, black_clock_time = 0;
+
     bool auto_play_white = false, auto_play_black = false;
     bool lock_display = DEFAULT_LOCK_DISPLAY;
+    // Print statistics after every search
+    bool show_search_stats = false;
+    // Search on the opponent's time, assuming they play the reply from the principal variation
+    bool ponder = DEFAULT_PONDER;
+    // Choose the computer's moves with Monte Carlo tree search, instead of alpha-beta search
+    bool use_mcts = false;
+    // Play moves from the opening book, when the position is in it
+    bool use_book = DEFAULT_USE_BOOK;
+    // Whether a ponder search is running, the position it is searching, and the move expected to reach it
+    bool is_pondering = false;
+    PlyContext ponder_context;
+    char ponder_move[6] = "";
+    // Input received while the computer was thinking, which is handled once it has moved
+    PendingInputs pending = { .length = 0 };
     bool display_as_white = true;
     for (;;) {
         char input[256] = "";
@@ -53,39 +248,13 @@ int main(int argc, char **argv) {
             printf("%0.2f\n", raw_eval / 1000);
         }
 
-        // printf("HASH: %lu %lu\n", context.hash.alpha, context.hash.beta);
-        // printf("Repetitions: %u\n", state_repetitions(&history, context.hash));
+        // printf("HASH: %lu\n", context.hash);
+        // printf("Repetitions: %u\n", n_state_repetitions(&history.repetitions, &context));
 
         free(legal_moves.moves);
         legal_moves = get_all_legal_moves(&context);
         for (int i = 0; i < legal_moves.n_moves; i++) {
-            Piece piece = context.our_pieces[legal_moves.moves[i].piece_id];
-
-            legal_move_codes[i][0] = piece.x + 'a';
-            legal_move_codes[i][1] = piece.y + '1';
-            legal_move_codes[i][2] = legal_moves.moves[i].to_x + 'a';
-            legal_move_codes[i][3] = legal_moves.moves[i].to_y + '1';
-            switch (legal_moves.moves[i].special_move) {
-                case PromoteKnight:
-                    legal_move_codes[i][4] = 'n';
-                    legal_move_codes[i][5] = '\0';
-                    break;
-                case PromoteBishop:
-                    legal_move_codes[i][4] = 'b';
-                    legal_move_codes[i][5] = '\0';
-                    break;
-                case PromoteRook:
-                    legal_move_codes[i][4] = 'r';
-                    legal_move_codes[i][5] = '\0';
-                    break;
-                case PromoteQueen:
-                    legal_move_codes[i][4] = 'q';
-                    legal_move_codes[i][5] = '\0';
-                    break;
-                default:
-                    legal_move_codes[i][4] = '\0';
-                    break;
-            }
+            get_move_code(&context, legal_moves.moves[i], legal_move_codes[i]);
         }
 
         if (legal_moves.n_moves == 0) {
@@ -97,7 +266,7 @@ int main(int argc, char **argv) {
             break;
         }
 
-        if (is_repetition_draw(&history.repetitions, context.hash)) {
+        if (is_repetition_draw(&history.repetitions, &context)) {
             printf("Draw by repetition.\n");
             break;
         }
@@ -106,20 +275,30 @@ int main(int argc, char **argv) {
 
         // Set the input variable for this loop iteration, if applicable
         if (!should_auto_play) {
+            // Handle input that was entered while the computer was thinking first
+            if (pop_pending_input(&pending, input)) {
             // If there are more external commands to read, read them
-            if (arg_i < argc) {
+            } else if (arg_i < argc) {
                 strcpy(input, argv[arg_i++]);
             // If there are no more external commands to read, prompt the user
             } else {
                 printf("Enter a move or command: ");
-                if (!fgets(input, sizeof(input), stdin)) {
+                if (!read_input_line(input)) {
                     printf("Failed to read user input.\n");
                     break;
                 }
-                input[strcspn(input, "\n")] = 0;
             }
         }
 
+        // Anything other than the expected move, asking the computer to play, or checking on it ends pondering
+        if (is_pondering && !should_auto_play && (strcmp(input, ponder_move) != 0) && (strcmp(input, "play") != 0)
+            && (strcmp(input, "status") != 0)
+        ) {
+            stop_search();
+            wait_for_search();
+            is_pondering = false;
+        }
+
         // Reset the board
         if (strcmp(input, "help") == 0) {
             printf("Available commands:\n");
@@ -132,7 +311,30 @@ int main(int argc, char **argv) {
             printf("\thistory\t\tDisplay move history.\n");
             printf("\tlist\t\tList all legal moves for current position.\n");
             printf("\tperft <depth>\tCount all possible positions up to 'depth', starting from the current position.\n");
+            printf("\tbitbase\tDisplay where the endgame bitbases were loaded from.\n");
+            printf("\tbitbase build [file]\tSolve the endgame bitbases, and save them to 'file' (default: %s).\n", BITBASE_FILE);
+            printf("\tbitbase load <file>\tLoad endgame bitbases saved to 'file'.\n");
+            printf("\tbook [on|off]\tDisplay the opening book, or toggle playing moves from it.\n");
+            printf("\tbook load <file>\tOpen the opening book 'file'.\n");
+            printf("\tbook build <file> <games>...\tBuild an opening book 'file' from files of games, one per line in algebraic coordinates, and open it.\n");
+            printf("\tmate <n>\tSearch for a forced mate by the current player in at most 'n' moves.\n");
+            printf("\thash [MB]\tDisplay the move cache size, or resize (and clear) it to 'MB' megabytes.\n");
+            printf("\thash save <file>\tSave the move cache to 'file'.\n");
+            printf("\thash load <file>\tReplace the move cache with one saved to 'file'.\n");
+            printf("\tdepth <n>\tLimit searches to 'n' ply (0 for no limit).\n");
+            printf("\tmovetime <ms>\tLimit searches to 'ms' milliseconds per move (0 for no limit).\n");
+            printf("\tnodes <n>\tLimit searches to about 'n' nodes (0 for no limit).\n");
+            printf("\tclock <ms> [inc]\tGive both sides 'ms' milliseconds of thinking time, plus 'inc' per move (0 for no clock).\n");
+            printf("\tmultipv <n>\tSearch for the best 'n' lines, and display each line's score and moves.\n");
+            printf("\tthreads <n>\tSearch with 'n' threads.\n");
+            printf("\tstats [on|off]\tDisplay statistics from the last search, or toggle displaying them (and timing the search) after every search.\n");
+            printf("\tponder [on|off]\tToggle searching on the opponent's time, after the computer moves.\n");
+            printf("\tsearch [ab|mcts]\tDisplay or choose the search that selects the computer's moves: alpha-beta or Monte Carlo tree search.\n");
+            printf("\tprune [<technique> <on|off>]\tDisplay or toggle forward pruning techniques: futility, razoring, lmp.\n");
             printf("\tplay\t\tComputer makes the best move for the current player.\n");
+            printf("\tgo infinite\tAnalyze the current position until stopped.\n");
+            printf("\tstatus\t\tWhile the computer is thinking, display its search depth, best line, and nodes searched.\n");
+            printf("\tstop\t\tWhile the computer is thinking, stop and play the best move found so far.\n");
             printf("\tauto\t\tEnable automatic play for the current player.\n");
             printf("\t<move>\t\tEnter a legal move in algebraic coordinates (e.g., e2e4, g7g8q). Promotion suffixes: n=Knight, b=Bishop, r=Rook, q=Queen.\n");
             continue;
@@ -142,6 +344,7 @@ int main(int argc, char **argv) {
         if (strcmp(input, "reset") == 0) {
             print_history(&history);
             clear_history(&history);
+            clear_cache();
             new_context(&context);
             continue;
         }
@@ -222,7 +425,7 @@ int main(int argc, char **argv) {
                 PlyContext branch;
                 uint64_t branch_nodes;
                 for (int i = 0; i < legal_moves.n_moves; i++) {
-                    new_context_branch(&context, &branch, legal_moves.moves[i]);
+                    new_scratch_branch(&context, &branch, legal_moves.moves[i]);
                     branch_nodes = perft(&branch, depth - 1);
                     printf("\t%s: %lu nodes\n", legal_move_codes[i], branch_nodes);
                     nodes += branch_nodes;
@@ -235,6 +438,322 @@ int main(int argc, char **argv) {
             continue;
         }
 
+        // Solve the endgame bitbases
+        if ((strcmp(input, "bitbase build") == 0) || (strncmp(input, "bitbase build ", 14) == 0)) {
+            const char *path = input[13] == ' ' ? input + 14 : BITBASE_FILE;
+            printf("Generating endgame bitbases...\n");
+            fflush(stdout);
+            uint64_t start_time = get_time_ms();
+            generate_bitbases();
+            printf("Generated endgame bitbases in %lu ms.\n", get_time_ms() - start_time);
+            if (save_bitbases(path)) {
+                printf("Saved endgame bitbases to '%s'.\n\n", path);
+            } else {
+                printf("Failed to save endgame bitbases to '%s'.\n\n", path);
+            }
+            continue;
+        }
+
+        // Load the endgame bitbases
+        if (strncmp(input, "bitbase load ", 13) == 0) {
+            if (load_bitbases(input + 13)) {
+                printf("Loaded endgame bitbases from '%s'.\n\n", input + 13);
+            } else {
+                printf("Failed to load endgame bitbases from '%s'.\n\n", input + 13);
+            }
+            continue;
+        }
+
+        // Display the endgame bitbases
+        if (strcmp(input, "bitbase") == 0) {
+            if (!are_bitbases_available()) {
+                printf("Endgame bitbases: none. Use 'bitbase build' to solve them.\n\n");
+            } else if (get_bitbase_path() == NULL) {
+                printf("Endgame bitbases: generated, not saved.\n\n");
+            } else {
+                printf("Endgame bitbases: '%s'\n\n", get_bitbase_path());
+            }
+            continue;
+        }
+
+        // Build an opening book
+        if (strncmp(input, "book build ", 11) == 0) {
+            char args[256];
+            strcpy(args, input + 11);
+            const char *paths[64];
+            int n_paths = 0;
+            for (char *token = strtok(args, " "); (token != NULL) && (n_paths < 64); token = strtok(NULL, " ")) {
+                paths[n_paths++] = token;
+            }
+            if (n_paths < 2) {
+                printf("Usage: book build <file> <games>...\n\n");
+                continue;
+            }
+
+            uint32_t n_games;
+            uint64_t n_entries;
+            if (!build_book(paths[0], paths + 1, n_paths - 1, &n_games, &n_entries)) {
+                printf("Failed to build the opening book '%s'.\n\n", paths[0]);
+                continue;
+            }
+            printf("Built the opening book '%s' from %u games, with %lu entries.\n", paths[0], n_games, n_entries);
+            if (open_book(paths[0])) {
+                printf("Opened the opening book.\n\n");
+            } else {
+                printf("Failed to open the opening book.\n\n");
+            }
+            continue;
+        }
+
+        // Open an opening book
+        if (strncmp(input, "book load ", 10) == 0) {
+            if (open_book(input + 10)) {
+                printf("Opened the opening book '%s', with %lu entries.\n\n", input + 10, get_book_size());
+            } else {
+                printf("Failed to open the opening book '%s'.\n\n", input + 10);
+            }
+            continue;
+        }
+
+        // Display or toggle the opening book
+        if (strncmp(input, "book", 4) == 0) {
+            if ((strcmp(input, "book on") == 0) || (strcmp(input, "book off") == 0)) {
+                use_book = strcmp(input, "book on") == 0;
+            } else if (strcmp(input, "book") != 0) {
+                printf("Invalid book command.\n\n");
+                continue;
+            }
+            if (get_book_path() == NULL) {
+                printf("Opening book: none, %s\n\n", use_book ? "on" : "off");
+            } else {
+                printf("Opening book: '%s' (%lu entries), %s\n\n", get_book_path(), get_book_size(), use_book ? "on" : "off");
+            }
+            continue;
+        }
+
+        // Search for a forced mate
+        if (strncmp(input, "mate ", 5) == 0) {
+            uint32_t max_moves;
+            if ((sscanf(input + 5, "%u", &max_moves) != 1) || (max_moves == 0) || (max_moves > MAX_MATE_MOVES)) {
+                printf("Invalid number of moves (must be between 1 and %d).\n\n", MAX_MATE_MOVES);
+                continue;
+            }
+
+            printf("Searching for mate in at most %u move%s...\n", max_moves, max_moves == 1 ? "" : "s");
+            fflush(stdout);
+            uint64_t start_time = get_time_ms();
+            MateSearchResult result = find_mate(&context, max_moves);
+            uint64_t elapsed_time = get_time_ms() - start_time;
+            if (result.status == MateFound) {
+                printf("Mate in %u: ", result.n_moves);
+                print_moves(&context, result.line, result.line_length);
+                printf("\n");
+            } else if (result.status == MateNotFound) {
+                printf("No mate within %u move%s.\n", max_moves, max_moves == 1 ? "" : "s");
+            } else {
+                printf("Ran out of memory before finding a mate within %u move%s.\n", max_moves, max_moves == 1 ? "" : "s");
+            }
+            printf("Searched %lu nodes in %lu ms.\n\n", result.nodes, elapsed_time);
+            continue;
+        }
+
+        // Save the move cache
+        if (strncmp(input, "hash save ", 10) == 0) {
+            CacheFileStatus status = save_cache(input + 10);
+            if (status == CacheFileOk) {
+                printf("Saved move cache to '%s'.\n\n", input + 10);
+            } else {
+                printf("Failed to save move cache: %s.\n\n", get_cache_file_status_name(status));
+            }
+            continue;
+        }
+
+        // Load the move cache
+        if (strncmp(input, "hash load ", 10) == 0) {
+            CacheFileStatus status = load_cache(input + 10);
+            if (status == CacheFileOk) {
+                printf("Loaded move cache from '%s' (%lu MB).\n\n", input + 10, get_cache_size_bytes() / (1024 * 1024));
+            } else {
+                printf("Failed to load move cache: %s.\n\n", get_cache_file_status_name(status));
+            }
+            continue;
+        }
+
+        // Display or resize the move cache
+        if (strncmp(input, "hash", 4) == 0) {
+            uint64_t size_mb;
+            if (strcmp(input, "hash") == 0) {
+                // Just display the current size
+            } else if ((sscanf(input + 4, "%lu", &size_mb) != 1) || (size_mb == 0)) {
+                printf("Invalid size.\n\n");
+                continue;
+            } else if (!resize_cache(size_mb)) {
+                printf("Failed to allocate a %lu MB move cache.\n", size_mb);
+            }
+            printf("Move cache size: %lu MB (%s).\n\n",
+                get_cache_size_bytes() / (1024 * 1024), get_cache_memory_name(get_cache_memory()));
+            continue;
+        }
+
+        // Set the maximum search depth
+        if (strncmp(input, "depth ", 6) == 0) {
+            int32_t depth;
+            if ((sscanf(input + 6, "%d", &depth) != 1) || (depth < 0)) {
+                printf("Invalid depth.\n\n");
+                continue;
+            }
+            limits.depth = depth;
+            if (depth == 0) {
+                printf("Search depth is no longer limited.\n\n");
+            } else {
+                printf("Search depth limited to %d ply.\n\n", depth);
+            }
+            continue;
+        }
+
+        // Set the time per move
+        if (strncmp(input, "movetime ", 9) == 0) {
+            uint64_t move_time;
+            if (sscanf(input + 9, "%lu", &move_time) != 1) {
+                printf("Invalid time.\n\n");
+                continue;
+            }
+            limits.move_time = move_time;
+            if (move_time == 0) {
+                printf("Search time per move is no longer limited.\n\n");
+            } else {
+                printf("Search time limited to %lu ms per move.\n\n", move_time);
+            }
+            continue;
+        }
+
+        // Set the node limit
+        if (strncmp(input, "nodes ", 6) == 0) {
+            uint64_t nodes;
+            if (sscanf(input + 6, "%lu", &nodes) != 1) {
+                printf("Invalid node count.\n\n");
+                continue;
+            }
+            limits.nodes = nodes;
+            if (nodes == 0) {
+                printf("Search nodes are no longer limited.\n\n");
+            } else {
+                printf("Search limited to about %lu nodes per move.\n\n", nodes);
+            }
+            continue;
+        }
+
+        // Set the number of lines to search
+        if (strncmp(input, "multipv ", 8) == 0) {
+            uint32_t multi_pv;
+            if ((sscanf(input + 8, "%u", &multi_pv) != 1) || (multi_pv < 1) || (multi_pv > MAX_MULTI_PV)) {
+                printf("Invalid number of lines. Choose between 1 and %d.\n\n", MAX_MULTI_PV);
+                continue;
+            }
+            limits.multi_pv = multi_pv;
+            printf("Searching for the best %u line%s.\n\n", multi_pv, multi_pv == 1 ? "" : "s");
+            continue;
+        }
+
+        // Start the clocks
+        if (strncmp(input, "clock ", 6) == 0) {
+            uint64_t clock_time, increment = 0;
+            if (sscanf(input + 6, "%lu %lu", &clock_time, &increment) < 1) {
+                printf("Invalid time.\n\n");
+                continue;
+            }
+            white_clock_time = clock_time;
+            black_clock_time = clock_time;
+            limits.clock_increment = clock_time == 0 ? 0 : increment;
+            if (clock_time == 0) {
+                printf("Clocks disabled.\n\n");
+            } else {
+                printf("Clocks set to %lu ms, plus %lu ms per move.\n\n", clock_time, limits.clock_increment);
+            }
+            continue;
+        }
+
+        // Set the number of search threads
+        if (strncmp(input, "threads ", 8) == 0) {
+            uint32_t n_threads;
+            if ((sscanf(input + 8, "%u", &n_threads) != 1) || (n_threads == 0)) {
+                printf("Invalid thread count.\n\n");
+                continue;
+            }
+            set_search_threads(n_threads);
+            printf("Searching with %u thread%s.\n\n", get_search_threads(), get_search_threads() == 1 ? "" : "s");
+            continue;
+        }
+
+        // Display statistics from the last search, or toggle displaying them after every search
+        if (strncmp(input, "stats", 5) == 0) {
+            if (strcmp(input, "stats") == 0) {
+                print_search_stats(get_last_search_stats());
+            } else if ((strcmp(input, "stats on") == 0) || (strcmp(input, "stats off") == 0)) {
+                show_search_stats = strcmp(input, "stats on") == 0;
+                set_search_profiling(show_search_stats);
+                printf("Search statistics %s.\n\n", show_search_stats ? "enabled" : "disabled");
+            } else {
+                printf("Usage: stats [on|off]\n\n");
+            }
+            continue;
+        }
+
+        // Toggle pondering
+        if (strncmp(input, "ponder", 6) == 0) {
+            if (strcmp(input, "ponder") == 0) {
+                ponder = !ponder;
+            } else if ((strcmp(input, "ponder on") == 0) || (strcmp(input, "ponder off") == 0)) {
+                ponder = strcmp(input, "ponder on") == 0;
+            } else {
+                printf("Usage: ponder [on|off]\n\n");
+                continue;
+            }
+            printf("Pondering %s.\n\n", ponder ? "enabled" : "disabled");
+            continue;
+        }
+
+        // Display or toggle forward pruning techniques
+        if (strncmp(input, "prune", 5) == 0) {
+            PruningOptions *options = get_pruning_options();
+            char technique[32], setting[8];
+            if (strcmp(input, "prune") != 0) {
+                if ((sscanf(input + 5, "%31s %7s", technique, setting) != 2)
+                    || ((strcmp(setting, "on") != 0) && (strcmp(setting, "off") != 0))
+                ) {
+                    printf("Usage: prune <futility|razoring|lmp> <on|off>\n\n");
+                    continue;
+                }
+                bool enabled = strcmp(setting, "on") == 0;
+                if (strcmp(technique, "futility") == 0) {
+                    options->futility_pruning = enabled;
+                } else if (strcmp(technique, "razoring") == 0) {
+                    options->razoring = enabled;
+                } else if (strcmp(technique, "lmp") == 0) {
+                    options->late_move_pruning = enabled;
+                } else {
+                    printf("Unknown pruning technique '%s'.\n\n", technique);
+                    continue;
+                }
+            }
+            printf("Futility pruning: %s\n", options->futility_pruning ? "on" : "off");
+            printf("Razoring: %s\n", options->razoring ? "on" : "off");
+            printf("Late move pruning (lmp): %s\n\n", options->late_move_pruning ? "on" : "off");
+            continue;
+        }
+
+        // Choose the search backend
+        if (strncmp(input, "search", 6) == 0) {
+            if ((strcmp(input, "search ab") == 0) || (strcmp(input, "search mcts") == 0)) {
+                use_mcts = strcmp(input, "search mcts") == 0;
+            } else if (strcmp(input, "search") != 0) {
+                printf("Invalid search (must be 'ab' or 'mcts').\n\n");
+                continue;
+            }
+            printf("Search: %s\n\n", use_mcts ? "Monte Carlo tree search (mcts)" : "alpha-beta (ab)");
+            continue;
+        }
+
         // From now on, auto-play as this color
         if (strcmp(input, "auto") == 0) {
             if (context.is_white) {
@@ -248,44 +767,116 @@ int main(int argc, char **argv) {
             continue;
         }
 
+        // Check on the computer's search
+        if (strcmp(input, "status") == 0) {
+            SearchStatus status = get_search_status();
+            if (status.running) {
+                print_search_status(&ponder_context, &status);
+            } else {
+                printf("The computer is not thinking.\n\n");
+            }
+            continue;
+        }
+
+        // The computer is only ever stopped while it is thinking
+        if (strcmp(input, "stop") == 0) {
+            printf("The computer is not thinking.\n\n");
+            continue;
+        }
+
+        // Analyze the position until stopped
+        if (strcmp(input, "go infinite") == 0) {
+            SearchLimits analysis_limits = limits;
+            analysis_limits.depth = 0;
+            analysis_limits.move_time = 0;
+            analysis_limits.clock_time = 0;
+            analysis_limits.nodes = 0;
+            if (!start_search(&history.repetitions, &context, &analysis_limits, false)) {
+                printf("Failed to start the search.\n\n");
+                continue;
+            }
+            printf("Analyzing. Enter 'stop' to stop, or 'status' to see the best line so far.\n");
+            fflush(stdout);
+            BestMove best_move = await_search(&context, &pending, false);
+
+            char move_str[6];
+            get_move_code(&context, best_move.move, move_str);
+            printf("Best move: %s\n", move_str);
+            print_search_lines(&context, get_last_search_stats());
+            if (show_search_stats)
+                print_search_stats(get_last_search_stats());
+            continue;
+        }
+
         // Computer should play this move
         if ((strcmp(input, "play") == 0) || should_auto_play) {
             printf("Computer is thinking...");
             fflush(stdout);
-            BestMove best_move = get_best_move_ab(&history.repetitions, &context, MOVE_SEARCH_DEPTH);
+            uint64_t *clock_time = context.is_white ? &white_clock_time : &black_clock_time;
+            limits.clock_time = *clock_time;
+            uint64_t start_time = get_time_ms();
+            BestMove best_move;
+            Move book_move;
+            bool is_book_move = use_book && probe_book(&context, &book_move);
+            if (is_book_move) {
+                if (is_pondering) {
+                    stop_search();
+                    wait_for_search();
+                }
+                best_move = (BestMove){0, book_move};
+            } else if (use_mcts) {
+                best_move = get_best_move_mcts(&history.repetitions, &context, &limits);
+            } else if (is_pondering && (context.hash == ponder_context.hash)) {
+                // Ponder hit: the search of this position is already underway, and only needs its limits enforced
+                ponder_hit();
+                best_move = await_search(&context, &pending, is_search_limited(&limits));
+            } else {
+                if (is_pondering) {
+                    stop_search();
+                    wait_for_search();
+                }
+                // Search in the background, so that the search can be stopped or checked on.
+                // If the search thread can't be started, search on this thread instead.
+                if (start_search(&history.repetitions, &context, &limits, false)) {
+                    best_move = await_search(&context, &pending, is_search_limited(&limits));
+                } else {
+                    best_move = get_best_move_ab(&history.repetitions, &context, &limits);
+                }
+            }
+            is_pondering = false;
 
-            Piece piece = context.our_pieces[best_move.move.piece_id];
+            // Run the clock
+            if (*clock_time != 0) {
+                uint64_t elapsed = get_time_ms() - start_time;
+                *clock_time = (*clock_time > elapsed ? *clock_time - elapsed : 1) + limits.clock_increment;
+            }
 
             char move_str[6];
-            move_str[0] = piece.x + 'a';
-            move_str[1] = piece.y + '1';
-            move_str[2] = best_move.move.to_x + 'a';
-            move_str[3] = best_move.move.to_y + '1';
-            switch (best_move.move.special_move) {
-                case PromoteKnight:
-                    move_str[4] = 'n';
-                    move_str[5] = '\0';
-                    break;
-                case PromoteBishop:
-                    move_str[4] = 'b';
-                    move_str[5] = '\0';
-                    break;
-                case PromoteRook:
-                    move_str[4] = 'r';
-                    move_str[5] = '\0';
-                    break;
-                case PromoteQueen:
-                    move_str[4] = 'q';
-                    move_str[5] = '\0';
-                    break;
-                default:
-                    move_str[4] = '\0';
-                    break;
-            }
+            get_move_code(&context, best_move.move, move_str);
 
             append_history(&history, &context, move_str);
-            printf(" %s\n\n", move_str);
+            printf(" %s%s\n\n", move_str, is_book_move ? " (book)" : "");
+            if (!is_book_move && (limits.multi_pv > 1))
+                print_search_lines(&context, get_last_search_stats());
+            if (!is_book_move && show_search_stats)
+                print_search_stats(get_last_search_stats());
             update_context(&context, best_move.move);
+
+            // Ponder on the expected reply, unless the computer is playing it too
+            SearchStats *stats = get_last_search_stats();
+            bool opponent_auto_play = context.is_white ? auto_play_white : auto_play_black;
+            if (ponder && !use_mcts && !is_book_move && !opponent_auto_play && (stats->lines[0].pv_length >= 2)) {
+                new_context_branch(&context, &ponder_context, stats->lines[0].pv[1]);
+                // Our clock is the one that will be running once the reply is played
+                SearchLimits ponder_limits = limits;
+                ponder_limits.clock_time = *clock_time;
+                push_state_repetition(&history.repetitions, context.hash);
+                is_pondering = start_search(&history.repetitions, &ponder_context, &ponder_limits, true);
+                pop_state_repetition(&history.repetitions);
+                get_move_code(&context, stats->lines[0].pv[1], ponder_move);
+                if (is_pondering)
+                    printf("Pondering on %s.\n\n", ponder_move);
+            }
             continue;
         }
 
@@ -304,9 +895,15 @@ int main(int argc, char **argv) {
             printf("Please enter a valid move or command.\n\n");
         }
     }
+    if (is_pondering) {
+        stop_search();
+        wait_for_search();
+    }
     print_history(&history);
     free_history(&history);
     free(legal_moves.moves);
     free(legal_move_codes);
+    free_cache();
+    close_book();
     return 0;
 }
\ No newline at end of file
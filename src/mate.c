@@ -0,0 +1,203 @@
+#include <stdlib.h>
+
+#include "mate.h"
+#include "context.h"
+#include "movegen.h"
+
+// Proof and disproof numbers are saturated at this value, which also marks a solved node
+#define PN_INFINITY UINT32_MAX
+
+// A node of the proof-number search tree.
+// Nodes only store the move that reaches them, and positions are replayed from the root when descending.
+typedef struct {
+    Move move;
+    uint32_t parent;
+    // Children are allocated consecutively, starting at first_child
+    uint32_t first_child;
+    uint8_t n_children;
+    bool is_expanded;
+    // The minimum number of leaves that must be proven to prove (or disprove) a mate here
+    uint32_t proof;
+    uint32_t disproof;
+} MateNode;
+
+typedef struct {
+    MateNode *nodes;
+    uint32_t n_nodes;
+    uint32_t capacity;
+} MateTree;
+
+uint32_t add_saturated(uint32_t a, uint32_t b) {
+    return (a > PN_INFINITY - b) ? PN_INFINITY : a + b;
+}
+
+// Sets the proof numbers of a new node.
+// At our turn (an OR node) one mating move is enough, and at the defender's turn (an AND node) every reply must lose.
+// Unsolved nodes start from their number of moves, since nodes with fewer options are easier to solve.
+void init_mate_node(MateNode *node, PlyContext *context, bool is_attacker, uint32_t plies_left) {
+    MoveList legal_moves = get_all_legal_moves(context);
+    uint8_t n_moves = legal_moves.n_moves;
+    free(legal_moves.moves);
+
+    node->first_child = 0;
+    node->n_children = 0;
+    node->is_expanded = false;
+    if (n_moves == 0) {
+        // Checkmating the defender proves the node, and anything else disproves it
+        bool is_mate = !is_attacker && is_in_check(context);
+        node->proof = is_mate ? 0 : PN_INFINITY;
+        node->disproof = is_mate ? PN_INFINITY : 0;
+    } else if (plies_left == 0) {
+        node->proof = PN_INFINITY;
+        node->disproof = 0;
+    } else {
+        node->proof = is_attacker ? 1 : n_moves;
+        node->disproof = is_attacker ? n_moves : 1;
+    }
+}
+
+// Recomputes a node's proof numbers from its children
+void update_mate_node(MateTree *tree, MateNode *node, bool is_attacker) {
+    uint32_t min_value = PN_INFINITY, sum = 0;
+    for (uint32_t i = 0; i < node->n_children; i++) {
+        MateNode *child = &tree->nodes[node->first_child + i];
+        uint32_t minimized = is_attacker ? child->proof : child->disproof;
+        uint32_t summed = is_attacker ? child->disproof : child->proof;
+        if (minimized < min_value)
+            min_value = minimized;
+        sum = add_saturated(sum, summed);
+    }
+    node->proof = is_attacker ? min_value : sum;
+    node->disproof = is_attacker ? sum : min_value;
+}
+
+// Adds a child for every legal move. Returns false if the node table is full.
+bool expand_mate_node(MateTree *tree, uint32_t node_i, PlyContext *context, bool is_attacker, uint32_t plies_left) {
+    MoveList legal_moves = get_all_legal_moves(context);
+    if (tree->n_nodes + legal_moves.n_moves > tree->capacity) {
+        free(legal_moves.moves);
+        return false;
+    }
+
+    uint32_t first_child = tree->n_nodes;
+    tree->n_nodes += legal_moves.n_moves;
+    PlyContext branch;
+    for (int i = 0; i < legal_moves.n_moves; i++) {
+        MateNode *child = &tree->nodes[first_child + i];
+        child->move = legal_moves.moves[i];
+        child->parent = node_i;
+        new_scratch_branch(context, &branch, legal_moves.moves[i]);
+        init_mate_node(child, &branch, !is_attacker, plies_left - 1);
+    }
+    free(legal_moves.moves);
+
+    MateNode *node = &tree->nodes[node_i];
+    node->first_child = first_child;
+    node->n_children = legal_moves.n_moves;
+    node->is_expanded = true;
+    return true;
+}
+
+// The number of plies to mate in a proven subtree, assuming we mate as fast as possible and the defender delays
+uint32_t get_mate_length(MateTree *tree, MateNode *node, bool is_attacker, Move *line) {
+    if (!node->is_expanded)
+        return 0;
+
+    uint32_t best_length = 0;
+    int best_i = -1;
+    Move best_line[2 * MAX_MATE_MOVES];
+    for (uint32_t i = 0; i < node->n_children; i++) {
+        MateNode *child = &tree->nodes[node->first_child + i];
+        if (child->proof != 0)
+            continue;
+        Move child_line[2 * MAX_MATE_MOVES];
+        uint32_t length = 1 + get_mate_length(tree, child, !is_attacker, child_line);
+        if ((best_i == -1) || (is_attacker ? length < best_length : length > best_length)) {
+            best_i = i;
+            best_length = length;
+            best_line[0] = child->move;
+            for (uint32_t j = 1; j < length; j++) {
+                best_line[j] = child_line[j - 1];
+            }
+        }
+    }
+    for (uint32_t j = 0; j < best_length; j++) {
+        line[j] = best_line[j];
+    }
+    return best_length;
+}
+
+// Proof-number search for mate in exactly max_plies plies or fewer
+MateSearchStatus _find_mate(MateTree *tree, PlyContext *context, uint32_t max_plies) {
+    tree->n_nodes = 1;
+    MateNode *root = &tree->nodes[0];
+    root->move = NULL_MOVE;
+    root->parent = 0;
+    init_mate_node(root, context, true, max_plies);
+
+    PlyContext position;
+    while ((root->proof != 0) && (root->disproof != 0)) {
+        // Descend to the most proving node: the child that is cheapest to prove at our turn,
+        // and the child that is cheapest to disprove at the defender's turn
+        uint32_t node_i = 0;
+        uint32_t ply = 0;
+        copy_context(context, &position);
+        while (tree->nodes[node_i].is_expanded) {
+            MateNode *node = &tree->nodes[node_i];
+            bool is_attacker = (ply % 2) == 0;
+            uint32_t best_i = node->first_child;
+            for (uint32_t i = 1; i < node->n_children; i++) {
+                MateNode *child = &tree->nodes[node->first_child + i];
+                MateNode *best = &tree->nodes[best_i];
+                if (is_attacker ? child->proof < best->proof : child->disproof < best->disproof)
+                    best_i = node->first_child + i;
+            }
+            update_context_no_prefetch(&position, tree->nodes[best_i].move);
+            node_i = best_i;
+            ply++;
+        }
+
+        if (!expand_mate_node(tree, node_i, &position, (ply % 2) == 0, max_plies - ply))
+            return MateOutOfMemory;
+
+        // Propagate the new proof numbers up the tree, until they stop changing
+        for (;;) {
+            MateNode *node = &tree->nodes[node_i];
+            uint32_t proof = node->proof, disproof = node->disproof;
+            update_mate_node(tree, node, (ply % 2) == 0);
+            if ((node_i == 0) || ((node->proof == proof) && (node->disproof == disproof)))
+                break;
+            node_i = node->parent;
+            ply--;
+        }
+    }
+    return root->proof == 0 ? MateFound : MateNotFound;
+}
+
+MateSearchResult find_mate(PlyContext *context, uint32_t max_moves) {
+    MateSearchResult result = {.status = MateNotFound, .n_moves = 0, .line_length = 0, .nodes = 0};
+    if (max_moves > MAX_MATE_MOVES)
+        max_moves = MAX_MATE_MOVES;
+
+    MateTree tree;
+    tree.capacity = (uint32_t)(((uint64_t)MATE_SEARCH_MEMORY_MB * 1024 * 1024) / sizeof(MateNode));
+    tree.nodes = malloc((uint64_t)tree.capacity * sizeof(MateNode));
+    if (tree.nodes == NULL) {
+        result.status = MateOutOfMemory;
+        return result;
+    }
+
+    for (uint32_t n_moves = 1; n_moves <= max_moves; n_moves++) {
+        result.status = _find_mate(&tree, context, 2 * n_moves - 1);
+        result.nodes += tree.n_nodes;
+        if (result.status == MateFound) {
+            result.line_length = get_mate_length(&tree, &tree.nodes[0], true, result.line);
+            result.n_moves = (result.line_length + 1) / 2;
+            break;
+        }
+        if (result.status == MateOutOfMemory)
+            break;
+    }
+    free(tree.nodes);
+    return result;
+}
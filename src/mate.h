@@ -0,0 +1,32 @@
+#ifndef MATE_H
+#define MATE_H
+
+#include "types.h"
+#include "config.h"
+
+typedef enum {
+    // A forced mate was proven
+    MateFound = 0,
+    // Every line was shown to avoid mate within the given number of moves
+    MateNotFound,
+    // The node table filled up before the search could finish
+    MateOutOfMemory,
+} MateSearchStatus;
+
+typedef struct {
+    MateSearchStatus status;
+    // The number of our moves needed to mate, if found
+    uint32_t n_moves;
+    // A mating line, with the longest defense at every reply
+    Move line[2 * MAX_MATE_MOVES];
+    uint32_t line_length;
+    // The number of nodes created in the node table
+    uint64_t nodes;
+} MateSearchResult;
+
+// Proof-number search for a forced mate by the side to move, in at most max_moves of its moves.
+// Searches for mate in 1, then 2, and so on, so that the shortest mate is found.
+// Repetitions and the 50-move rule are ignored.
+MateSearchResult find_mate(PlyContext *context, uint32_t max_moves);
+
+#endif
@@ -0,0 +1,331 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcts.h"
+#include "config.h"
+#include "constants.h"
+#include "context.h"
+#include "movegen.h"
+#include "eval.h"
+#include "order.h"
+#include "see.h"
+#include "history.h"
+#include "timer.h"
+#include "atomic.h"
+
+// Playout results are summed as fixed point integers, so that they can be updated atomically
+#define MCTS_VALUE_SCALE 65536
+// The main thread checks the time whenever its playout count is a multiple of the interval
+#define MCTS_TIME_CHECK_INTERVAL_MASK 63
+
+typedef enum {
+    NodeUnexpanded = 0,
+    // Another thread is adding this node's children
+    NodeExpanding = 1,
+    // The children have been added. Nodes without children are checkmate or stalemate.
+    NodeExpanded = 2,
+} MctsNodeState;
+
+typedef struct {
+    // The move that reaches this node from its parent
+    Move move;
+    // Children are allocated consecutively, starting at first_child
+    uint32_t first_child;
+    // The probability that selection assigns to this move before it has been visited
+    float prior;
+    // Playouts through this node, including those still in progress, which count as virtual losses
+    int32_t visits;
+    // The sum of playout results, from the point of view of the side that played move, in units of 1 / MCTS_VALUE_SCALE
+    int64_t value_sum;
+    uint8_t n_children;
+    uint8_t state;
+} MctsNode;
+
+typedef struct {
+    MctsNode *nodes;
+    uint32_t n_nodes;
+    uint32_t capacity;
+    // Set once an expansion has failed for lack of space, so that later playouts don't try again
+    bool is_full;
+
+    PlyContext root;
+    bool stop;
+    uint64_t playouts;
+    uint64_t playout_limit;
+    // Absolute time in milliseconds, or 0 for no deadline
+    uint64_t deadline;
+} MctsTree;
+
+typedef struct {
+    MctsTree *tree;
+    // Each thread pushes its playout path onto a private copy of the game's repetitions
+    StateRepetitions repetitions;
+    bool is_main;
+    pthread_t thread;
+} MctsWorker;
+
+// Maps an evaluation to a playout result between -1 and 1
+double get_eval_value(int32_t score) {
+    return tanh(score / MCTS_EVAL_SCALE);
+}
+
+// Maps a playout result back to an evaluation
+int32_t get_value_eval(double value) {
+    if (value > 0.999)
+        value = 0.999;
+    if (value < -0.999)
+        value = -0.999;
+    return (int32_t)(atanh(value) * MCTS_EVAL_SCALE);
+}
+
+// Adds a child for each legal move, with priors that favor captures that don't lose material, and promotions.
+// Returns false if the tree is out of space.
+bool expand_mcts_node(MctsTree *tree, MctsNode *node, PlyContext *context, MoveList legal_moves) {
+    if (ATOMIC_LOAD(&tree->is_full))
+        return false;
+    uint32_t end = ATOMIC_ADD(&tree->n_nodes, legal_moves.n_moves);
+    if (end > tree->capacity) {
+        ATOMIC_STORE(&tree->is_full, true);
+        return false;
+    }
+
+    uint32_t first_child = end - legal_moves.n_moves;
+    double total_weight = 0;
+    for (int i = 0; i < legal_moves.n_moves; i++) {
+        Move move = legal_moves.moves[i];
+        bool is_promotion = (move.special_move >= PromoteKnight) && (move.special_move <= PromoteQueen);
+        bool is_tactical = is_promotion || (is_capture(context, move) && !is_losing_capture(context, move));
+        MctsNode *child = &tree->nodes[first_child + i];
+        child->move = move;
+        child->first_child = 0;
+        child->prior = is_tactical ? MCTS_TACTICAL_PRIOR : 1.0;
+        child->visits = 0;
+        child->value_sum = 0;
+        child->n_children = 0;
+        child->state = NodeUnexpanded;
+        total_weight += child->prior;
+    }
+    for (int i = 0; i < legal_moves.n_moves; i++) {
+        tree->nodes[first_child + i].prior /= total_weight;
+    }
+
+    node->first_child = first_child;
+    node->n_children = legal_moves.n_moves;
+    return true;
+}
+
+// PUCT: picks the child with the best sum of its average result and an exploration bonus,
+// which grows with the child's prior and shrinks as it is visited
+MctsNode *select_mcts_child(MctsTree *tree, MctsNode *node) {
+    int32_t parent_visits = ATOMIC_LOAD(&node->visits);
+    double exploration = MCTS_EXPLORATION * sqrt(parent_visits > 1 ? parent_visits : 1);
+    // Unvisited children are assumed to be as good as the parent, from the point of view of the side to move there
+    double parent_value = parent_visits > 0
+        ? -(double)ATOMIC_LOAD(&node->value_sum) / MCTS_VALUE_SCALE / parent_visits
+        : 0;
+
+    MctsNode *best_child = NULL;
+    double best_score = -INFINITY;
+    for (uint32_t i = 0; i < node->n_children; i++) {
+        MctsNode *child = &tree->nodes[node->first_child + i];
+        int32_t visits = ATOMIC_LOAD(&child->visits);
+        double value = visits > 0
+            ? (double)ATOMIC_LOAD(&child->value_sum) / MCTS_VALUE_SCALE / visits
+            : parent_value;
+        double score = value + exploration * child->prior / (1 + visits);
+        if (score > best_score) {
+            best_score = score;
+            best_child = child;
+        }
+    }
+    return best_child;
+}
+
+// Adds or removes virtual losses, which make a node look worse to other threads while a playout passes through it
+void add_virtual_loss(MctsNode *node, int32_t n_losses) {
+    ATOMIC_ADD(&node->visits, n_losses);
+    ATOMIC_ADD(&node->value_sum, -(int64_t)n_losses * MCTS_VALUE_SCALE);
+}
+
+// Scores a leaf from the point of view of the side to move there, expanding it if no other thread is
+double evaluate_mcts_leaf(MctsTree *tree, MctsNode *node, PlyContext *context) {
+    uint8_t state = ATOMIC_LOAD_ACQUIRE(&node->state);
+    if (state == NodeExpanded) {
+        // Expanded nodes without children are mate or stalemate. Others are only leaves because the path reached
+        // MAX_SEARCH_PLY, so they are scored like any unexpanded leaf.
+        if (node->n_children == 0)
+            return is_in_check(context) ? -1 : 0;
+        return get_eval_value(evaluate_material(context, NULL));
+    }
+
+    uint8_t expected = NodeUnexpanded;
+    if ((state == NodeExpanding) || !ATOMIC_COMPARE_EXCHANGE(&node->state, &expected, NodeExpanding))
+        return get_eval_value(evaluate_leaf(context, is_in_check(context), NULL));
+
+    MoveList legal_moves = get_all_legal_moves(context);
+    bool expanded = (legal_moves.n_moves == 0) || expand_mcts_node(tree, node, context, legal_moves);
+    ATOMIC_STORE_RELEASE(&node->state, expanded ? NodeExpanded : NodeUnexpanded);
+    double value = get_eval_value(evaluate_with(context, legal_moves));
+    free(legal_moves.moves);
+    return value;
+}
+
+// Descends from the root to a leaf, scores it, and adds the result to every node on the way
+void run_playout(MctsTree *tree, StateRepetitions *repetitions) {
+    MctsNode *path[MAX_SEARCH_PLY];
+    uint32_t path_length = 0;
+    PlyContext position;
+    copy_context(&tree->root, &position);
+
+    MctsNode *node = &tree->nodes[0];
+    bool is_draw = false;
+    for (;;) {
+        add_virtual_loss(node, MCTS_VIRTUAL_LOSS);
+        path[path_length++] = node;
+        if ((path_length == MAX_SEARCH_PLY) || (ATOMIC_LOAD_ACQUIRE(&node->state) != NodeExpanded)
+            || (node->n_children == 0)
+        )
+            break;
+
+        node = select_mcts_child(tree, node);
+        push_state_repetition(repetitions, position.hash);
+        update_context_no_prefetch(&position, node->move);
+        if (is_repetition_draw(repetitions, &position)) {
+            add_virtual_loss(node, MCTS_VIRTUAL_LOSS);
+            path[path_length++] = node;
+            is_draw = true;
+            break;
+        }
+    }
+    for (uint32_t i = 1; i < path_length; i++) {
+        pop_state_repetition(repetitions);
+    }
+
+    // Results alternate in sign up the path, since each node is scored for the side that moved into it
+    double value = is_draw ? 0 : -evaluate_mcts_leaf(tree, path[path_length - 1], &position);
+    for (uint32_t i = path_length; i-- > 0;) {
+        ATOMIC_ADD(&path[i]->visits, 1 - MCTS_VIRTUAL_LOSS);
+        ATOMIC_ADD(
+            &path[i]->value_sum,
+            (int64_t)(value * MCTS_VALUE_SCALE) + (int64_t)MCTS_VIRTUAL_LOSS * MCTS_VALUE_SCALE
+        );
+        value = -value;
+    }
+}
+
+void *_mcts_worker_thread(void *arg) {
+    MctsWorker *worker = arg;
+    MctsTree *tree = worker->tree;
+    while (!ATOMIC_LOAD(&tree->stop)) {
+        run_playout(tree, &worker->repetitions);
+        uint64_t playouts = ATOMIC_ADD(&tree->playouts, 1);
+        if (playouts >= tree->playout_limit) {
+            ATOMIC_STORE(&tree->stop, true);
+        } else if (worker->is_main && (tree->deadline != 0) && ((playouts & MCTS_TIME_CHECK_INTERVAL_MASK) == 0)
+            && (get_time_ms() >= tree->deadline)
+        ) {
+            ATOMIC_STORE(&tree->stop, true);
+        }
+    }
+    return NULL;
+}
+
+// The child with the most visits, which is the most thoroughly tested move, or NULL if there are no children
+MctsNode *get_most_visited_child(MctsTree *tree, MctsNode *node) {
+    if (ATOMIC_LOAD_ACQUIRE(&node->state) != NodeExpanded)
+        return NULL;
+    MctsNode *best_child = NULL;
+    for (uint32_t i = 0; i < node->n_children; i++) {
+        MctsNode *child = &tree->nodes[node->first_child + i];
+        if ((best_child == NULL) || (child->visits > best_child->visits))
+            best_child = child;
+    }
+    return best_child;
+}
+
+BestMove get_best_move_mcts(StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits) {
+    uint64_t start_time = get_time_us();
+    BestMove best_move = {.score = 0, .move = NULL_MOVE};
+    SearchStats *stats = get_last_search_stats();
+    memset(stats, 0, sizeof(SearchStats));
+
+    MctsTree tree;
+    tree.capacity = (uint32_t)(((uint64_t)MCTS_MEMORY_MB * 1024 * 1024) / sizeof(MctsNode));
+    tree.nodes = malloc((uint64_t)tree.capacity * sizeof(MctsNode));
+    if (tree.nodes == NULL)
+        return best_move;
+    tree.n_nodes = 1;
+    tree.is_full = false;
+    copy_context(context, &tree.root);
+    tree.stop = false;
+    tree.playouts = 0;
+
+    uint64_t soft_deadline;
+    get_search_deadlines(limits, start_time / 1000, &soft_deadline, &tree.deadline);
+    tree.playout_limit = limits->nodes;
+    if (tree.playout_limit == 0)
+        tree.playout_limit = tree.deadline == 0 ? MCTS_DEFAULT_PLAYOUTS : UINT64_MAX;
+
+    MctsNode *root = &tree.nodes[0];
+    root->move = NULL_MOVE;
+    root->first_child = 0;
+    root->prior = 1;
+    root->visits = 0;
+    root->value_sum = 0;
+    root->n_children = 0;
+    root->state = NodeUnexpanded;
+    evaluate_mcts_leaf(&tree, root, &tree.root);
+    if (root->n_children == 0) {
+        free(tree.nodes);
+        return best_move;
+    }
+
+    uint32_t n_workers = get_search_threads();
+    MctsWorker *workers = malloc(sizeof(MctsWorker) * n_workers);
+    uint32_t n_started = 0;
+    for (uint32_t i = 1; i < n_workers; i++) {
+        MctsWorker *worker = &workers[n_started];
+        worker->tree = &tree;
+        worker->is_main = false;
+        copy_state_repetitions(repetitions, &worker->repetitions);
+        if (pthread_create(&worker->thread, NULL, _mcts_worker_thread, worker) == 0) {
+            n_started++;
+        } else {
+            free_state_repetitions(&worker->repetitions);
+        }
+    }
+
+    MctsWorker main_worker = {.tree = &tree, .is_main = true};
+    copy_state_repetitions(repetitions, &main_worker.repetitions);
+    _mcts_worker_thread(&main_worker);
+    free_state_repetitions(&main_worker.repetitions);
+    for (uint32_t i = 0; i < n_started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        free_state_repetitions(&workers[i].repetitions);
+    }
+    free(workers);
+
+    // Play the most visited move, and report the line that follows the most visited move at every node
+    MctsNode *best_child = get_most_visited_child(&tree, root);
+    best_move.move = best_child->move;
+    best_move.score = get_value_eval(
+        best_child->visits > 0 ? (double)best_child->value_sum / MCTS_VALUE_SCALE / best_child->visits : 0
+    );
+
+    SearchLine *line = &stats->lines[0];
+    line->score = best_move.score;
+    line->pv_length = 0;
+    for (MctsNode *node = best_child; (node != NULL) && (node->visits > 0) && (line->pv_length < MAX_SEARCH_PLY);
+        node = get_most_visited_child(&tree, node)
+    ) {
+        line->pv[line->pv_length++] = node->move;
+    }
+    stats->n_lines = 1;
+    stats->nodes = tree.playouts;
+    stats->time_us = get_time_us() - start_time;
+
+    free(tree.nodes);
+    return best_move;
+}
@@ -0,0 +1,15 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "types.h"
+#include "search.h"
+
+// Monte Carlo tree search, as an alternative to get_best_move_ab that takes the same arguments.
+// Each playout descends the tree by PUCT selection, adds the leaf's moves to the tree, and scores the leaf with the
+// static evaluation instead of playing the game out. Playouts run on get_search_threads() threads.
+// The search runs until the node limit (counted in playouts), the move time or the clock runs out,
+// or for MCTS_DEFAULT_PLAYOUTS playouts if none of those are set. The depth limit is ignored.
+// Statistics and the principal variation (the most visited line) are stored in get_last_search_stats().
+BestMove get_best_move_mcts(StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits);
+
+#endif
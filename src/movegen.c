@@ -340,7 +340,7 @@ bool is_legal_state(PlyContext *context) {
 bool is_in_check(PlyContext *context) {
     // Flip the perspective of the PlyContext from white to black or vice versa
     PlyContext opponent_context;
-    new_context_branch(context, &opponent_context, NULL_MOVE);
+    new_scratch_branch(context, &opponent_context, NULL_MOVE);
     return !is_legal_state(&opponent_context);
 }
 
@@ -352,7 +352,7 @@ MoveList filter_legal_pseudo_moves(PlyContext *context, MoveList move_list) {
     PlyContext branch;
 
     for (int i = 0; i < move_list.n_moves; i++) {
-        new_context_branch(context, &branch, move_list.moves[i]);
+        new_scratch_branch(context, &branch, move_list.moves[i]);
         if (is_legal_state(&branch)) {
             moves[n_moves++] = move_list.moves[i];
         }
@@ -398,7 +398,7 @@ uint64_t get_our_attack_bb(PlyContext *context) {
 uint64_t get_opponent_attack_bb(PlyContext *context) {
     // Flip the perspective of the PlyContext from white to black or vice versa
     PlyContext branch;
-    new_context_branch(context, &branch, NULL_MOVE);
+    new_scratch_branch(context, &branch, NULL_MOVE);
     return get_our_attack_bb(&branch);
 }
 
@@ -474,6 +474,55 @@ MoveList get_all_legal_moves(PlyContext *context) {
     return (MoveList){total_moves, total_n_moves};
 }
 
+// Gets all legal captures and promotions (including en passant).
+// Castling is never a capture, so it is not considered.
+MoveList get_all_legal_captures(PlyContext *context) {
+    uint8_t total_n_moves = 0;
+    Move *total_moves;
+    uint8_t n_move_lists = 0;
+    MoveList move_lists[16];
+
+    uint8_t promotion_y = context->is_white ? 7 : 0;
+    MoveList raw_piece_moves, piece_moves;
+    for (int i = 0; i < 16; i++) {
+        GET_PSEUDO_LEGAL_MOVES_GENERIC(raw_piece_moves, context->our_pieces[i].type, context, i)
+
+        // Drop the quiet moves before the (more expensive) legality check
+        uint8_t n_tactical_moves = 0;
+        for (int j = 0; j < raw_piece_moves.n_moves; j++) {
+            Move move = raw_piece_moves.moves[j];
+            bool is_tactical = (move.special_move == EnPassant)
+                || ((GET_MOVE_BB_MASK(move) & context->opponent_bb) != 0)
+                || ((context->our_pieces[i].type == Pawn) && (move.to_y == promotion_y));
+            if (is_tactical) {
+                raw_piece_moves.moves[n_tactical_moves++] = move;
+            }
+        }
+        raw_piece_moves.n_moves = n_tactical_moves;
+
+        // We will free this later, when collecting the legal moves from all pieces
+        piece_moves = filter_legal_pseudo_moves(context, raw_piece_moves);
+        // Free the unfiltered move list for each piece
+        free(raw_piece_moves.moves);
+
+        total_n_moves += piece_moves.n_moves;
+        move_lists[n_move_lists++] = piece_moves;
+    }
+
+    // Add each piece's legal moves to the total legal moves
+    total_moves = malloc(sizeof(Move) * total_n_moves);
+    total_n_moves = 0;
+    for (int i = 0; i < n_move_lists; i++) {
+        for (int j = 0; j < move_lists[i].n_moves; j++) {
+            total_moves[total_n_moves++] = move_lists[i].moves[j];
+        }
+        // Free the filtered move list for each piece
+        free(move_lists[i].moves);
+    }
+
+    return (MoveList){total_moves, total_n_moves};
+}
+
 bool has_legal_move(PlyContext *context) {
     MoveList raw_piece_moves, piece_moves;
     for (int i = 0; i < 16; i++) {
@@ -499,7 +548,7 @@ uint64_t perft(PlyContext *context, uint8_t depth) {
     uint64_t total = 0;
     for (int i = 0; i < legal_moves.n_moves; i++) {
         PlyContext branch;
-        new_context_branch(context, &branch, legal_moves.moves[i]);
+        new_scratch_branch(context, &branch, legal_moves.moves[i]);
         total += perft(&branch, depth - 1);
     }
     free(legal_moves.moves);
@@ -45,6 +45,9 @@ MoveList get_legal_moves_castling(PlyContext *context, uint64_t opponent_attack_
 
 MoveList get_all_legal_moves(PlyContext *context);
 
+// Gets all legal captures and promotions (including en passant).
+MoveList get_all_legal_captures(PlyContext *context);
+
 bool has_legal_move(PlyContext *context);
 
 uint64_t perft(PlyContext *context, uint8_t depth);
@@ -0,0 +1,127 @@
+#include "order.h"
+#include "position.h"
+#include "see.h"
+
+// Ordering score tiers. Scores within a tier never overlap with the next one.
+#define HASH_MOVE_SCORE (1 << 30)
+#define CAPTURE_SCORE (1 << 28)
+#define FIRST_KILLER_SCORE ((1 << 27) + 1)
+#define SECOND_KILLER_SCORE (1 << 27)
+// Captures that lose material are searched after every quiet move, ordered by how much they lose
+#define LOSING_CAPTURE_SCORE (-(1 << 27))
+// History scores are halved whenever one reaches this, so they stay below the killer tier
+#define MAX_HISTORY_SCORE (1 << 20)
+
+// Relative piece values, for ordering only. The king is the least valuable victim, since it can't be captured,
+// and the most valuable attacker, since it can never be defended against.
+static const int32_t ORDER_PIECE_RANKS[7] = {
+    [NullPiece] = 0,
+    [King] = 6,
+    [Pawn] = 1,
+    [Knight] = 2,
+    [Bishop] = 3,
+    [Rook] = 4,
+    [Queen] = 5,
+};
+
+bool is_same_move(Move a, Move b) {
+    return (a.piece_id == b.piece_id) && (a.to_x == b.to_x) && (a.to_y == b.to_y) && (a.special_move == b.special_move);
+}
+
+bool is_capture(PlyContext *context, Move move) {
+    return (move.special_move == EnPassant) || ((GET_MOVE_BB_MASK(move) & context->opponent_bb) != 0);
+}
+
+PieceType get_captured_piece_type(PlyContext *context, Move move) {
+    if (move.special_move == EnPassant)
+        return Pawn;
+    if ((GET_MOVE_BB_MASK(move) & context->opponent_bb) == 0)
+        return NullPiece;
+
+    for (int i = 0; i < 16; i++) {
+        Piece piece = context->opponent_pieces[i];
+        if ((piece.type != NullPiece) && (piece.x == move.to_x) && (piece.y == move.to_y))
+            return piece.type;
+    }
+    return NullPiece;
+}
+
+bool is_promotion(Move move) {
+    return (move.special_move >= PromoteKnight) && (move.special_move <= PromoteQueen);
+}
+
+void score_moves(
+    PlyContext *context, MoveList *move_list, int32_t *scores,
+    Move hash_move, Move killers[2], MoveHistory history
+) {
+    for (int i = 0; i < move_list->n_moves; i++) {
+        Move move = move_list->moves[i];
+        PieceType victim = get_captured_piece_type(context, move);
+
+        if (is_same_move(move, hash_move)) {
+            scores[i] = HASH_MOVE_SCORE;
+        } else if ((victim != NullPiece) || is_promotion(move)) {
+            PieceType attacker = context->our_pieces[move.piece_id].type;
+            // Only captures by a more valuable piece can lose material, so only those need an exchange evaluation
+            int32_t exchange = (victim != NullPiece) && !is_promotion(move)
+                && (ORDER_PIECE_RANKS[attacker] > ORDER_PIECE_RANKS[victim]) && (attacker != King)
+                ? see(context, move) : 0;
+            if (exchange < 0) {
+                scores[i] = LOSING_CAPTURE_SCORE + exchange;
+                continue;
+            }
+            scores[i] = CAPTURE_SCORE + (ORDER_PIECE_RANKS[victim] << 4) - ORDER_PIECE_RANKS[attacker];
+            if (is_promotion(move)) {
+                scores[i] += ORDER_PIECE_RANKS[move.special_move] << 4;
+            }
+        } else if (is_same_move(move, killers[0])) {
+            scores[i] = FIRST_KILLER_SCORE;
+        } else if (is_same_move(move, killers[1])) {
+            scores[i] = SECOND_KILLER_SCORE;
+        } else {
+            Piece piece = context->our_pieces[move.piece_id];
+            scores[i] = history[context->is_white][piece.type][GET_MOVE_POS(move)];
+        }
+    }
+}
+
+void pick_next_move(MoveList *move_list, int32_t *scores, int i) {
+    int best_i = i;
+    for (int j = i + 1; j < move_list->n_moves; j++) {
+        if (scores[j] > scores[best_i])
+            best_i = j;
+    }
+    if (best_i != i) {
+        Move tmp_move = move_list->moves[i];
+        move_list->moves[i] = move_list->moves[best_i];
+        move_list->moves[best_i] = tmp_move;
+
+        int32_t tmp_score = scores[i];
+        scores[i] = scores[best_i];
+        scores[best_i] = tmp_score;
+    }
+}
+
+void update_killers(Move killers[2], Move move) {
+    if (!is_same_move(move, killers[0])) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+}
+
+void update_history(MoveHistory history, PlyContext *context, Move move, int32_t bonus) {
+    Piece piece = context->our_pieces[move.piece_id];
+    int32_t *entry = &history[context->is_white][piece.type][GET_MOVE_POS(move)];
+    *entry += bonus;
+
+    // Age the whole table rather than letting scores grow into the killer tier
+    if ((*entry >= MAX_HISTORY_SCORE) || (*entry <= -MAX_HISTORY_SCORE)) {
+        for (int color = 0; color < 2; color++) {
+            for (int type = 0; type < 7; type++) {
+                for (int pos = 0; pos < 64; pos++) {
+                    history[color][type][pos] /= 2;
+                }
+            }
+        }
+    }
+}
\ No newline at end of file
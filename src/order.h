@@ -0,0 +1,35 @@
+#ifndef ORDER_H
+#define ORDER_H
+
+#include "types.h"
+
+// How often quiet moves have caused cutoffs, indexed by color, piece type, and target square
+typedef int32_t MoveHistory[2][7][64];
+
+bool is_same_move(Move a, Move b);
+
+// Whether the move captures a piece, including en passant
+bool is_capture(PlyContext *context, Move move);
+
+// The type of the piece that the move captures, or NullPiece if it is not a capture
+PieceType get_captured_piece_type(PlyContext *context, Move move);
+
+// Assigns each move an ordering score. Higher scores are searched first:
+// the hash move, then captures and promotions (most valuable victim, least valuable attacker),
+// then killer moves, then the remaining quiet moves by history, then captures that lose material.
+void score_moves(
+    PlyContext *context, MoveList *move_list, int32_t *scores,
+    Move hash_move, Move killers[2], MoveHistory history
+);
+
+// Moves the highest scoring move at or after index i to index i.
+// This is a partial selection sort, so moves that are never searched are never sorted.
+void pick_next_move(MoveList *move_list, int32_t *scores, int i);
+
+// Records a quiet move that caused a cutoff at this ply
+void update_killers(Move killers[2], Move move);
+
+// Rewards (or penalizes, if bonus is negative) a quiet move in the history table
+void update_history(MoveHistory history, PlyContext *context, Move move, int32_t bonus);
+
+#endif
\ No newline at end of file
@@ -13,6 +13,8 @@ uint64_t BISHOP_POSSIBLE_ATTACK_BB_TABLE[64];
 uint64_t ROOK_POSSIBLE_ATTACK_BB_TABLE[64];
 uint64_t QUEEN_POSSIBLE_ATTACK_BB_TABLE[64];
 
+uint64_t BETWEEN_BB_TABLE[64][64];
+
 uint8_t WHITE_PAWN_POSSIBLE_N_MOVES_TABLE[64];
 uint8_t BLACK_PAWN_POSSIBLE_N_MOVES_TABLE[64];
 uint8_t KING_POSSIBLE_N_MOVES_TABLE[64];
@@ -43,6 +45,31 @@ uint8_t QUEEN_POSSIBLE_N_MOVES_TABLE[64];
 #define INIT_PIECE_TABLE(piece_type, pseudo_legal_move_gen, attack_table_name, move_n_table_name) \
     INIT_PAWN_TABLE(piece_type, pseudo_legal_move_gen, attack_table_name, move_n_table_name, 0, 7, true)
 
+void init_between_table(void) {
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            BETWEEN_BB_TABLE[from][to] = 0;
+        }
+    }
+
+    // Walk each of the 8 directions from every square, marking the squares passed on the way
+    const int directions[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    for (int from = 0; from < 64; from++) {
+        for (int d = 0; d < 8; d++) {
+            uint64_t between = 0;
+            int x = (from & 7) + directions[d][0];
+            int y = (from >> 3) + directions[d][1];
+            while ((x >= 0) && (x <= 7) && (y >= 0) && (y <= 7)) {
+                int to = (y << 3) + x;
+                BETWEEN_BB_TABLE[from][to] = between;
+                between |= (uint64_t)1 << to;
+                x += directions[d][0];
+                y += directions[d][1];
+            }
+        }
+    }
+}
+
 void init_precomp(void) {
     INIT_PAWN_TABLE(Pawn, get_pseudo_legal_moves_pawn,
         WHITE_PAWN_POSSIBLE_ATTACK_BB_TABLE, WHITE_PAWN_POSSIBLE_N_MOVES_TABLE, 0, 6, true)
@@ -58,6 +85,7 @@ void init_precomp(void) {
         ROOK_POSSIBLE_ATTACK_BB_TABLE, ROOK_POSSIBLE_N_MOVES_TABLE)
     INIT_PIECE_TABLE(Queen, get_pseudo_legal_moves_queen,
         QUEEN_POSSIBLE_ATTACK_BB_TABLE, QUEEN_POSSIBLE_N_MOVES_TABLE)
+    init_between_table();
 }
 
 uint64_t get_piece_possible_attack_bb(Piece piece, bool is_white) {
@@ -13,6 +13,9 @@ extern uint64_t BISHOP_POSSIBLE_ATTACK_BB_TABLE[64];
 extern uint64_t ROOK_POSSIBLE_ATTACK_BB_TABLE[64];
 extern uint64_t QUEEN_POSSIBLE_ATTACK_BB_TABLE[64];
 
+// The squares strictly between two squares that share a rank, file, or diagonal, or 0 if they share none
+extern uint64_t BETWEEN_BB_TABLE[64][64];
+
 extern uint8_t WHITE_PAWN_POSSIBLE_N_MOVES_TABLE[64];
 extern uint8_t BLACK_PAWN_POSSIBLE_N_MOVES_TABLE[64];
 extern uint8_t KING_POSSIBLE_N_MOVES_TABLE[64];
@@ -1,4 +1,7 @@
+#include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "search.h"
 #include "movegen.h"
@@ -6,99 +9,1006 @@
 #include "context.h"
 #include "eval.h"
 #include "config.h"
+#include "constants.h"
 #include "hash.h"
+#include "cache.h"
 #include "history.h"
 #include "position.h"
+#include "timer.h"
+#include "order.h"
+#include "atomic.h"
+#include "see.h"
+#include "bitbase.h"
 
-const uint64_t MOVE_CACHE_SIZE = MOVE_CACHE_SIZE_BYTES / sizeof(BestMoveCacheEntry);
+// Limits and stop requests are checked whenever the node count is a multiple of the interval
+#define LIMIT_CHECK_INTERVAL_MASK (SEARCH_CHECK_INTERVAL - 1)
 
-uint64_t get_table_index(ContextHash hash) {
-    return (hash.alpha % MOVE_CACHE_SIZE);
+// State shared by every thread of a search
+typedef struct {
+    // Set by the main thread when every thread should stop, or by the caller to end the search early
+    bool stop;
+    // Set while searching on the opponent's time, when limits are not enforced. Cleared on a ponder hit.
+    bool pondering;
+    // When the ponder hit happened, in milliseconds. It is written before pondering is cleared.
+    uint64_t ponder_hit_time;
+    // Nodes searched by all threads, updated in batches
+    uint64_t nodes;
+
+    // The deepest iteration completed by the main thread, and its best line, for reporting while the search runs
+    pthread_mutex_t progress_lock;
+    int32_t completed_depth;
+    SearchLine best_line;
+} SharedSearchState;
+
+// The state of a single search thread
+typedef struct {
+    SharedSearchState *shared;
+    // Only the main thread enforces limits, and only its result is played
+    bool is_main;
+
+    // Node counts and other statistics for this thread
+    SearchStats stats;
+    // Whether to time move generation and evaluation
+    bool profiled;
+    // The limits of the search, and when it started, in milliseconds.
+    // When pondering, the clock only starts at the ponder hit, since the time before it was the opponent's.
+    SearchLimits limits;
+    uint64_t start_time;
+    bool pondering;
+    uint64_t node_limit;
+    // Absolute times, in milliseconds. 0 means there is no deadline.
+    // No new iteration is started after the soft deadline, and the search is aborted at the hard deadline.
+    uint64_t soft_deadline;
+    uint64_t hard_deadline;
+    // Whether the limits may abort the current iteration. The first iteration always runs to completion.
+    bool can_stop;
+    // Whether the search has been aborted. Results from aborted searches must be discarded.
+    bool stopped;
+    // Set while verifying a null move cutoff, so that the verification can't itself be cut off by a null move
+    bool null_move_disabled;
+    // The best move from the previous iteration, which is searched first at the root
+    Move root_move;
+    // The number of lines to find at the root, and the moves that start the lines already found this iteration.
+    // Those moves are left out of the root, so that the next search finds the next best line.
+    uint32_t multi_pv;
+    Move excluded_root_moves[MAX_MULTI_PV];
+    uint32_t n_excluded_root_moves;
+
+    // Move ordering heuristics
+    Move killers[MAX_SEARCH_PLY][2];
+    MoveHistory history;
+
+    // Triangular principal variation table. pv[ply] holds the best line found from ply, up to pv_length[ply].
+    Move pv[MAX_SEARCH_PLY][MAX_SEARCH_PLY];
+    uint8_t pv_length[MAX_SEARCH_PLY];
+} SearchState;
+
+// Arguments for a helper thread
+typedef struct {
+    SearchState state;
+    // Each thread pushes its own search path onto a private copy of the game's repetitions
+    StateRepetitions repetitions;
+    PlyContext context;
+    int32_t start_depth;
+    int32_t max_depth;
+    pthread_t thread;
+} SearchHelper;
+
+static uint32_t n_search_threads = 1;
+
+static PruningOptions pruning_options = {
+    .futility_pruning = USE_FUTILITY_PRUNING,
+    .razoring = USE_RAZORING,
+    .late_move_pruning = USE_LATE_MOVE_PRUNING
+};
+
+PruningOptions *get_pruning_options(void) {
+    return &pruning_options;
+}
+
+static SearchStats last_search_stats;
+static bool search_profiling = false;
+
+SearchStats *get_last_search_stats(void) {
+    return &last_search_stats;
+}
+
+void set_search_profiling(bool enabled) {
+    search_profiling = enabled;
+}
+
+bool get_search_profiling(void) {
+    return search_profiling;
+}
+
+// Depth reductions, in ply, for null moves (by depth) and late moves (by depth and move index)
+static int32_t null_move_reductions[MAX_SEARCH_PLY];
+static int32_t late_move_reductions[64][64];
+
+void init_search(void) {
+    for (int depth = 0; depth < MAX_SEARCH_PLY; depth++) {
+        null_move_reductions[depth] = NULL_MOVE_BASE_REDUCTION + depth / NULL_MOVE_DEPTH_DIVISOR;
+    }
+    // Reductions grow slowly with both depth and move index
+    for (int depth = 0; depth < 64; depth++) {
+        for (int i = 0; i < 64; i++) {
+            late_move_reductions[depth][i] = (depth == 0) || (i == 0) ? 0
+                : (int32_t)(LATE_MOVE_REDUCTION_BASE + log(depth) * log(i) / LATE_MOVE_REDUCTION_DIVISOR);
+        }
+    }
+}
+
+void set_search_threads(uint32_t n_threads) {
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > MAX_SEARCH_THREADS)
+        n_threads = MAX_SEARCH_THREADS;
+    n_search_threads = n_threads;
+}
+
+uint32_t get_search_threads(void) {
+    return n_search_threads;
+}
+
+SearchLimits new_search_limits(void) {
+    return (SearchLimits){
+        .depth = MOVE_SEARCH_DEPTH,
+        .move_time = 0,
+        .clock_time = 0,
+        .clock_increment = 0,
+        .nodes = 0,
+        .multi_pv = 1
+    };
+}
+
+// Mate scores are relative to the root, but a cached position can be reached at any ply.
+// Store them relative to the cached node instead, and convert back when probing.
+int32_t score_to_cache(int32_t score, int32_t ply) {
+    if (score >= MATE_SCORE_THRESHOLD)
+        return score + ply;
+    if (score <= -MATE_SCORE_THRESHOLD)
+        return score - ply;
+    return score;
+}
+
+int32_t score_from_cache(int32_t score, int32_t ply) {
+    if (score >= MATE_SCORE_THRESHOLD)
+        return score - ply;
+    if (score <= -MATE_SCORE_THRESHOLD)
+        return score + ply;
+    return score;
+}
+
+#define UPDATE_CACHE(_move, _score, _bound) \
+    store_cache(context->hash, (_move), score_to_cache((_score), ply), depth, (_bound));
+
+void get_search_deadlines(SearchLimits *limits, uint64_t now, uint64_t *soft_deadline, uint64_t *hard_deadline) {
+    *soft_deadline = 0;
+    *hard_deadline = 0;
+
+    if (limits->move_time != 0) {
+        *soft_deadline = now + limits->move_time;
+        *hard_deadline = now + limits->move_time;
+    }
+
+    if (limits->clock_time != 0) {
+        // Plan to spend an even share of the remaining time, plus most of the increment.
+        // A single iteration may overrun this, but never by enough to risk the clock.
+        uint64_t reserve = limits->clock_time > CLOCK_SAFETY_MARGIN_MS ? limits->clock_time - CLOCK_SAFETY_MARGIN_MS : 0;
+        uint64_t soft_time = limits->clock_time / CLOCK_MOVES_TO_GO + (limits->clock_increment * 3) / 4;
+        uint64_t hard_time = soft_time * CLOCK_HARD_LIMIT_MULTIPLIER;
+        if (hard_time > reserve / 2)
+            hard_time = reserve / 2;
+        if (soft_time > hard_time)
+            soft_time = hard_time;
+        // Always allow at least 1 ms, so that the deadlines remain enabled
+        soft_time = soft_time ? soft_time : 1;
+        hard_time = hard_time ? hard_time : 1;
+
+        if ((*soft_deadline == 0) || (now + soft_time < *soft_deadline))
+            *soft_deadline = now + soft_time;
+        if ((*hard_deadline == 0) || (now + hard_time < *hard_deadline))
+            *hard_deadline = now + hard_time;
+    }
+}
+
+// Sets the deadlines for a search that started at the given time
+void start_search_clock(SearchState *state, SearchLimits *limits, uint64_t now) {
+    get_search_deadlines(limits, now, &state->soft_deadline, &state->hard_deadline);
+}
+
+// Whether the search is still pondering. Once the ponder move is played, the clock starts from the ponder hit.
+bool is_pondering(SearchState *state) {
+    if (state->pondering && !ATOMIC_LOAD_ACQUIRE(&state->shared->pondering)) {
+        state->pondering = false;
+        start_search_clock(state, &state->limits, state->shared->ponder_hit_time);
+    }
+    return state->pondering;
+}
+
+void check_limits(SearchState *state) {
+    uint64_t total_nodes = ATOMIC_ADD(&state->shared->nodes, LIMIT_CHECK_INTERVAL_MASK + 1);
+    if (!state->is_main) {
+        state->stopped = ATOMIC_LOAD(&state->shared->stop);
+        return;
+    }
+
+    if (!state->can_stop)
+        return;
+    if (ATOMIC_LOAD(&state->shared->stop)) {
+        state->stopped = true;
+        return;
+    }
+    if (is_pondering(state))
+        return;
+    if ((state->node_limit != 0) && (total_nodes >= state->node_limit)) {
+        state->stopped = true;
+    } else if ((state->hard_deadline != 0) && (get_time_ms() >= state->hard_deadline)) {
+        state->stopped = true;
+    }
+    if (state->stopped) {
+        ATOMIC_STORE(&state->shared->stop, true);
+    }
+}
+
+// Scores a position that has no legal moves, preferring the quickest mate
+int32_t get_terminal_score(bool in_check, int32_t ply) {
+    return in_check ? LOSS_VALUE + ply : DRAW_VALUE;
+}
+
+// Whether we have any pieces other than pawns and the king.
+// Without them, zugzwang is common, and passing is often the best move, so null moves are unsound.
+bool has_non_pawn_material(PlyContext *context) {
+    for (int i = 0; i < 16; i++) {
+        PieceType type = context->our_pieces[i].type;
+        if ((type != NullPiece) && (type != King) && (type != Pawn))
+            return true;
+    }
+    return false;
+}
+
+// Removes a move from the list, if present, without preserving the order of the list
+void remove_move(MoveList *moves, Move move) {
+    for (int i = 0; i < moves->n_moves; i++) {
+        if (is_same_move(moves->moves[i], move)) {
+            moves->moves[i] = moves->moves[--moves->n_moves];
+            return;
+        }
+    }
 }
 
-BestMoveCache new_move_cache(void) {
-    BestMoveCacheEntry *entries = calloc(MOVE_CACHE_SIZE, sizeof(BestMoveCacheEntry));
-    return (BestMoveCache){entries};
+// Makes the move the start of the principal variation at this ply, followed by the principal variation of its branch
+void update_pv(SearchState *state, int32_t ply, Move move) {
+    state->pv[ply][ply] = move;
+    uint8_t length = ply + 1;
+    if (ply + 1 < MAX_SEARCH_PLY) {
+        for (; length < state->pv_length[ply + 1]; length++) {
+            state->pv[ply][length] = state->pv[ply + 1][length];
+        }
+    }
+    state->pv_length[ply] = length;
 }
 
-#define UPDATE_CACHE(_is_leaf) \
-    if ((cached.depth < depth) || !is_hash_eq(context->hash, cached.hash)) { \
-        cache->entries[get_table_index(context->hash)] = (BestMoveCacheEntry){ \
-            .hash = context->hash, \
-            .best_move = (best_move), \
-            .depth = depth, \
-            .is_leaf = _is_leaf \
-        }; \
+// Moves from the cache can cut the principal variation short, so extend it with cached moves, up to the given length
+void extend_pv_from_cache(PlyContext *context, Move *pv, uint32_t *pv_length, uint32_t max_length) {
+    PlyContext position;
+    copy_context(context, &position);
+    for (uint32_t i = 0; i < *pv_length; i++) {
+        update_context_no_prefetch(&position, pv[i]);
+    }
+
+    CacheEntry cached;
+    while ((*pv_length < max_length) && probe_cache(position.hash, &cached)
+        && (cached.move.special_move != NullMove)
+    ) {
+        // Cached moves may belong to another position with the same key
+        MoveList legal_moves = get_all_legal_moves(&position);
+        bool is_legal = false;
+        for (int i = 0; (i < legal_moves.n_moves) && !is_legal; i++) {
+            is_legal = is_same_move(legal_moves.moves[i], cached.move);
+        }
+        free(legal_moves.moves);
+        if (!is_legal)
+            break;
+
+        pv[(*pv_length)++] = cached.move;
+        update_context_no_prefetch(&position, cached.move);
     }
+}
 
-// Minimax search with alpha-beta pruning
-BestMove _get_best_move_ab(StateRepetitions *repetitions, PlyContext *context, int32_t depth, BestMoveCache *cache, int32_t floor, int32_t ceiling) {
-    // Check if the cache contains this state
-    BestMoveCacheEntry cached = cache->entries[get_table_index(context->hash)];
-    // TODO: Allow non-leaf results to be returned
-    if ((cached.depth >= depth) && is_hash_eq(context->hash, cached.hash)) {
-        return cached.best_move;
+// Generates legal moves (or only captures and promotions), timing it when profiling
+MoveList _generate_moves(SearchState *state, PlyContext *context, bool captures_only) {
+    if (!state->profiled)
+        return captures_only ? get_all_legal_captures(context) : get_all_legal_moves(context);
+    uint64_t start = get_time_us();
+    MoveList moves = captures_only ? get_all_legal_captures(context) : get_all_legal_moves(context);
+    state->stats.movegen_time_us += get_time_us() - start;
+    return moves;
+}
+
+// Evaluates a position that is not in check, timing it when profiling.
+// Quiescence leaves also detect stalemate when it is plausible, since their legal moves are never generated.
+int32_t _evaluate(SearchState *state, PlyContext *context, bool is_leaf, int32_t *our_material) {
+    if (!state->profiled)
+        return is_leaf ? evaluate_leaf(context, false, our_material) : evaluate_material(context, our_material);
+    uint64_t start = get_time_us();
+    int32_t score = is_leaf ? evaluate_leaf(context, false, our_material) : evaluate_material(context, our_material);
+    state->stats.eval_time_us += get_time_us() - start;
+    return score;
+}
+
+// Searches captures and promotions (or every move, when in check) until the position is quiet.
+// This keeps the main search from stopping in the middle of an exchange, and misjudging the position.
+int32_t _quiescence_search(SearchState *state, PlyContext *context, int32_t ply, int32_t floor, int32_t ceiling) {
+    state->stats.nodes++;
+    state->stats.qnodes++;
+    if ((state->stats.nodes & LIMIT_CHECK_INTERVAL_MASK) == 0)
+        check_limits(state);
+    if (state->stopped)
+        return 0;
+
+    if (ply >= MAX_SEARCH_PLY)
+        return _evaluate(state, context, false, NULL);
+
+    // When in check, standing pat is not an option, and every evasion must be searched
+    bool in_check = is_in_check(context);
+    int32_t stand_pat = -SCORE_INFINITY;
+    int32_t our_material = 1;
+    MoveList moves;
+    if (in_check) {
+        moves = _generate_moves(state, context, false);
+        if (moves.n_moves == 0) {
+            free(moves.moves);
+            return LOSS_VALUE + ply;
+        }
+    } else {
+        // Assume that we can do at least as well as the static evaluation, by declining every capture
+        stand_pat = _evaluate(state, context, true, &our_material);
+        if (stand_pat >= ceiling)
+            return stand_pat;
+        if (stand_pat > floor)
+            floor = stand_pat;
+        moves = _generate_moves(state, context, true);
+    }
+
+    int32_t move_scores[256];
+    Move no_killers[2] = {NULL_MOVE, NULL_MOVE};
+    score_moves(context, &moves, move_scores, NULL_MOVE, no_killers, state->history);
+
+    int32_t score = stand_pat;
+    PlyContext branch;
+    for (int i = 0; i < moves.n_moves; i++) {
+        pick_next_move(&moves, move_scores, i);
+        Move move = moves.moves[i];
+
+        // Delta pruning: skip captures that can't raise the score to the floor, even with a positional bonus
+        if (!in_check && ((move.special_move < PromoteKnight) || (move.special_move > PromoteQueen))) {
+            int32_t victim_value = get_piece_type_value(get_captured_piece_type(context, move));
+            int32_t best_gain = (10000 * (victim_value + DELTA_PRUNING_MARGIN)) / our_material;
+            if (stand_pat + best_gain <= floor)
+                continue;
+            // Captures that lose material once every recapture is resolved are very unlikely to help
+            if (is_losing_capture(context, move))
+                continue;
+        }
+
+        new_context_branch(context, &branch, move);
+        int32_t branch_score = -_quiescence_search(state, &branch, ply + 1, -ceiling, -floor);
+        if (state->stopped)
+            break;
+
+        if (branch_score > score)
+            score = branch_score;
+        if (score > floor)
+            floor = score;
+        if (score >= ceiling)
+            break;
+    }
+    free(moves.moves);
+    return score;
+}
+
+// Minimax search with alpha-beta pruning.
+// The true score is only guaranteed to be returned if it lies strictly between floor and ceiling.
+// Otherwise, the returned score is a bound in the direction of the failure.
+BestMove _get_best_move_ab(
+    SearchState *state, StateRepetitions *repetitions, PlyContext *context, int32_t depth, int32_t ply,
+    int32_t floor, int32_t ceiling
+) {
+    state->stats.nodes++;
+    if ((state->stats.nodes & LIMIT_CHECK_INTERVAL_MASK) == 0)
+        check_limits(state);
+    if (state->stopped)
+        return (BestMove){0, NULL_MOVE};
+    if (ply < MAX_SEARCH_PLY)
+        state->pv_length[ply] = ply;
+
+    // The bitbases know the exact result of positions with few pieces, including the distance to mate.
+    // The root always needs to be searched, since it must produce a move.
+    int32_t plies_to_mate;
+    BitbaseResult bitbase_result = ply > 0 ? probe_bitbase(context, &plies_to_mate) : BitbaseNone;
+    if (bitbase_result == BitbaseDraw)
+        return (BestMove){DRAW_VALUE, NULL_MOVE};
+    if (bitbase_result == BitbaseWin)
+        return (BestMove){WIN_VALUE - (ply + plies_to_mate), NULL_MOVE};
+    if (bitbase_result == BitbaseLoss)
+        return (BestMove){LOSS_VALUE + ply + plies_to_mate, NULL_MOVE};
+
+    // Check if the cache contains a usable result for this state.
+    // The root always needs to be searched, since it must produce a move.
+    CacheEntry cached;
+    Move cached_move = NULL_MOVE;
+    state->stats.cache_probes++;
+    if (probe_cache(context->hash, &cached)) {
+        state->stats.cache_hits++;
+        cached_move = cached.move;
+        int32_t cached_score = score_from_cache(cached.score, ply);
+        if ((ply > 0) && (cached.depth >= depth) && (
+            (cached.bound == BoundExact)
+            || ((cached.bound == BoundLower) && (cached_score >= ceiling))
+            || ((cached.bound == BoundUpper) && (cached_score <= floor))
+        )) {
+            return (BestMove){cached_score, cached.move};
+        }
     }
 
-    if (depth == 0) {
-        BestMove best_move = {evaluate(context), NULL_MOVE};
-        UPDATE_CACHE(true)
-        return best_move;
+    if ((depth <= 0) || (ply >= MAX_SEARCH_PLY)) {
+        int32_t score = _quiescence_search(state, context, ply, floor, ceiling);
+        if (state->stopped)
+            return (BestMove){0, NULL_MOVE};
+        CacheBound bound = (score >= ceiling) ? BoundLower
+            : (score <= floor) ? BoundUpper
+            : BoundExact;
+        UPDATE_CACHE(NULL_MOVE, score, bound)
+        return (BestMove){score, NULL_MOVE};
     }
 
-    MoveList legal_moves = get_all_legal_moves(context);
+    bool in_check = is_in_check(context);
+    bool is_pv_node = (ceiling - floor) > 1;
+    // The static evaluation is meaningless in check, since the position is not quiet
+    int32_t static_eval = in_check ? -SCORE_INFINITY : _evaluate(state, context, false, NULL);
+
+    // Razoring: near the horizon, if the static evaluation is far below the floor,
+    // only a tactic could save this node, so check with a quiescence search rather than a full search
+    if (pruning_options.razoring && !is_pv_node && !in_check
+        && (depth <= RAZORING_MAX_DEPTH)
+        && (static_eval + RAZORING_MARGIN * depth <= floor)
+    ) {
+        int32_t razor_score = _quiescence_search(state, context, ply, floor, floor + 1);
+        if (state->stopped)
+            return (BestMove){0, NULL_MOVE};
+        if (razor_score <= floor)
+            return (BestMove){razor_score, NULL_MOVE};
+    }
+
+    // Null move pruning: if passing our turn still fails high with a reduced search, a real move almost certainly would.
+    // Passing is illegal in check, and unsound in pawn endings, where zugzwang is common.
+    if (!is_pv_node && !in_check && (ply > 0) && !state->null_move_disabled
+        && (depth >= NULL_MOVE_MIN_DEPTH)
+        && (context->prev_move.special_move != NullMove)
+        && (ceiling < MATE_SCORE_THRESHOLD)
+        && has_non_pawn_material(context)
+        && (static_eval >= ceiling)
+    ) {
+        int32_t reduction = null_move_reductions[depth];
+        int32_t null_depth = depth - 1 - reduction > 0 ? depth - 1 - reduction : 0;
+        PlyContext branch;
+        new_context_branch(context, &branch, NULL_MOVE);
+        push_state_repetition(repetitions, context->hash);
+        int32_t null_score = -_get_best_move_ab(
+            state, repetitions, &branch, null_depth, ply + 1, -ceiling, -ceiling + 1
+        ).score;
+        pop_state_repetition(repetitions);
+        if (state->stopped)
+            return (BestMove){0, NULL_MOVE};
+
+        if (null_score >= ceiling) {
+            // Mates found after passing aren't real, so don't return them
+            if (null_score >= MATE_SCORE_THRESHOLD)
+                null_score = ceiling;
+
+            // At high depths, verify the cutoff with a reduced search of our real moves, without null moves.
+            // This catches zugzwang positions that slipped past the material check.
+            if (depth < NULL_MOVE_VERIFICATION_DEPTH)
+                return (BestMove){null_score, NULL_MOVE};
+            state->null_move_disabled = true;
+            int32_t verified_score = _get_best_move_ab(
+                state, repetitions, context, null_depth, ply, ceiling - 1, ceiling
+            ).score;
+            state->null_move_disabled = false;
+            if (state->stopped)
+                return (BestMove){0, NULL_MOVE};
+            if (verified_score >= ceiling)
+                return (BestMove){null_score, NULL_MOVE};
+        }
+    }
+
+    MoveList legal_moves = _generate_moves(state, context, false);
+    if (ply == 0) {
+        for (uint32_t i = 0; i < state->n_excluded_root_moves; i++) {
+            remove_move(&legal_moves, state->excluded_root_moves[i]);
+        }
+    }
     if (legal_moves.n_moves == 0) {
         free(legal_moves.moves);
-        BestMove best_move = {evaluate_with(context, legal_moves), NULL_MOVE};
-        UPDATE_CACHE(true)
-        return best_move;
+        int32_t score = get_terminal_score(in_check, ply);
+        UPDATE_CACHE(NULL_MOVE, score, BoundExact)
+        return (BestMove){score, NULL_MOVE};
+    }
+
+    // A cached move that isn't legal here must have been stored by another position with the same key
+    if (cached_move.special_move != NullMove) {
+        bool is_legal = false;
+        for (int i = 0; (i < legal_moves.n_moves) && !is_legal; i++) {
+            is_legal = is_same_move(legal_moves.moves[i], cached_move);
+        }
+        if (!is_legal)
+            state->stats.cache_collisions++;
     }
 
+    // Search the best move from a previous search first, since it is the most likely to cause a cutoff
+    int32_t move_scores[256];
+    score_moves(
+        context, &legal_moves, move_scores,
+        ply == 0 ? state->root_move : cached_move, state->killers[ply], state->history
+    );
+
+    // Forward pruning of quiet moves is only safe when we are not in check, and not trying to find an exact score
+    bool can_prune_quiet_moves = !is_pv_node && !in_check && (floor > -MATE_SCORE_THRESHOLD);
+    // Futility pruning: at frontier and pre-frontier nodes, a quiet move is unlikely to gain more than the margin
+    int32_t futility_score = static_eval + FUTILITY_MARGIN * depth;
+    bool is_futile = can_prune_quiet_moves && pruning_options.futility_pruning
+        && (depth <= FUTILITY_MAX_DEPTH) && (futility_score <= floor);
+    // Late move pruning: near the horizon, quiet moves ordered this late are skipped entirely
+    int32_t late_move_count = (pruning_options.late_move_pruning && (depth <= LATE_MOVE_PRUNING_MAX_DEPTH))
+        ? LATE_MOVE_PRUNING_BASE_MOVES + depth * depth : 256;
+
+    int32_t original_floor = floor;
     Move move = NULL_MOVE;
-    int32_t score = LOSS_VALUE * 2;
+    int32_t score = -SCORE_INFINITY;
+    // The quiet moves searched so far, which are penalized in the history table if a later move causes a cutoff
+    Move searched_quiet_moves[256];
+    int32_t n_searched_quiet_moves = 0;
     PlyContext branch;
     for (int i = 0; i < legal_moves.n_moves; i++) {
-        StateRepetitions reps_branch;
+        pick_next_move(&legal_moves, move_scores, i);
+
+        // Always search at least one move, so that there is a score to prune relative to
+        if (can_prune_quiet_moves && (i > 0)
+            && !is_capture(context, legal_moves.moves[i])
+            && ((legal_moves.moves[i].special_move < PromoteKnight) || (legal_moves.moves[i].special_move > PromoteQueen))
+        ) {
+            if (i >= late_move_count)
+                continue;
+            if (is_futile) {
+                // The pruned move is assumed to score no better than the futility score
+                if (futility_score > score)
+                    score = futility_score;
+                continue;
+            }
+        }
+
         new_context_branch(context, &branch, legal_moves.moves[i]);
-        _state_repetition_branch(repetitions, &reps_branch, branch.hash);
+        push_state_repetition(repetitions, context->hash);
+        // Draws by repetition aren't searched, so they have no principal variation of their own
+        if (ply + 1 < MAX_SEARCH_PLY)
+            state->pv_length[ply + 1] = ply + 1;
 
         int32_t branch_score;
-        if (is_repetition_draw(&reps_branch, branch.hash)) {
+        if (is_repetition_draw(repetitions, &branch)) {
             branch_score = DRAW_VALUE;
+        } else if (i == 0) {
+            // Principal variation search: the first move is assumed to be the best, so search it with the full window
+            branch_score = -_get_best_move_ab(
+                state, repetitions, &branch, depth - 1, ply + 1, -ceiling, -floor
+            ).score;
         } else {
-            int32_t new_depth = (
-                (depth == 1) && (GET_MOVE_BB_MASK(legal_moves.moves[i]) & branch.our_bb)
-            ) ? 1 : depth - 1;
+            // Late move reductions: quiet moves that were ordered late rarely turn out to be best,
+            // so search them less deeply, and only search them fully if they beat the best move so far.
+            int32_t reduction = 0;
+            Move move_i = legal_moves.moves[i];
+            if ((depth >= LATE_MOVE_REDUCTION_MIN_DEPTH) && (i >= LATE_MOVE_REDUCTION_MIN_MOVES) && !in_check
+                && !is_capture(context, move_i)
+                && ((move_i.special_move < PromoteKnight) || (move_i.special_move > PromoteQueen))
+            ) {
+                reduction = late_move_reductions[depth < 64 ? depth : 63][i < 64 ? i : 63];
+                if (is_pv_node && (reduction > 0))
+                    reduction--;
+                // Never reduce straight into the quiescence search
+                if (depth - 1 - reduction < 1)
+                    reduction = depth - 2 > 0 ? depth - 2 : 0;
+            }
 
-            BestMove opponent_best = _get_best_move_ab(&reps_branch, &branch, new_depth, cache, -ceiling, -floor);
-            branch_score = -opponent_best.score;
-            branch_score += branch_score > 0 ? -1: 1;
+            // Only prove that later moves are no better than the best so far, using a null window.
+            // If one turns out to be better, it has to be searched again with the full window to find its score.
+            branch_score = -_get_best_move_ab(
+                state, repetitions, &branch, depth - 1 - reduction, ply + 1, -floor - 1, -floor
+            ).score;
+            if ((reduction > 0) && (branch_score > floor) && !state->stopped) {
+                branch_score = -_get_best_move_ab(
+                    state, repetitions, &branch, depth - 1, ply + 1, -floor - 1, -floor
+                ).score;
+            }
+            if ((branch_score > floor) && (branch_score < ceiling) && !state->stopped) {
+                branch_score = -_get_best_move_ab(
+                    state, repetitions, &branch, depth - 1, ply + 1, -ceiling, -floor
+                ).score;
+            }
+        }
+        pop_state_repetition(repetitions);
+
+        // The branch's score is meaningless if it was aborted
+        if (state->stopped) {
+            free(legal_moves.moves);
+            return (BestMove){score, move};
         }
-        free_state_repetitions(&reps_branch);
 
         if (branch_score > score) {
             score = branch_score;
             move = legal_moves.moves[i];
         }
 
-        // TODO: account for floor/ceiling in cache
-        if (branch_score > ceiling)
-            ceiling = branch_score;
-        if (branch_score >= floor)
+        if (score > floor) {
+            floor = score;
+            update_pv(state, ply, move);
+        }
+        if (score >= ceiling) {
+            state->stats.cutoffs++;
+            if (i == 0)
+                state->stats.first_move_cutoffs++;
+            // Quiet moves that cause cutoffs are likely to do so in sibling positions too
+            if (!is_capture(context, move)) {
+                update_killers(state->killers[ply], move);
+                update_history(state->history, context, move, depth * depth);
+            }
+            // Penalize the quiet moves that were searched before it, and failed to cause a cutoff.
+            // Pruned moves were never searched, so nothing is known about them.
+            for (int j = 0; j < n_searched_quiet_moves; j++) {
+                update_history(state->history, context, searched_quiet_moves[j], -depth * depth);
+            }
             break;
+        }
+        if (!is_capture(context, legal_moves.moves[i]))
+            searched_quiet_moves[n_searched_quiet_moves++] = legal_moves.moves[i];
     }
-
     free(legal_moves.moves);
-    BestMove best_move = {score, move};
-    // TODO: Re-enable cache for non-leaf results.
-    // For some reason, these yield bad results?
-    // UPDATE_CACHE(false)
+
+    // A root searched without some of its moves has no true score to cache
+    if ((ply > 0) || (state->n_excluded_root_moves == 0)) {
+        CacheBound bound = (score >= ceiling) ? BoundLower
+            : (score <= original_floor) ? BoundUpper
+            : BoundExact;
+        UPDATE_CACHE(move, score, bound)
+    }
+    return (BestMove){score, move};
+}
+
+void new_search_state(SearchState *state, SharedSearchState *shared, bool is_main) {
+    state->shared = shared;
+    state->is_main = is_main;
+    memset(&state->stats, 0, sizeof(state->stats));
+    state->profiled = search_profiling && is_main;
+    state->start_time = 0;
+    state->pondering = false;
+    state->pv_length[0] = 0;
+    state->node_limit = 0;
+    state->soft_deadline = 0;
+    state->hard_deadline = 0;
+    state->can_stop = !is_main;
+    state->stopped = false;
+    state->null_move_disabled = false;
+    state->root_move = NULL_MOVE;
+    state->multi_pv = 1;
+    state->n_excluded_root_moves = 0;
+    for (int ply = 0; ply < MAX_SEARCH_PLY; ply++) {
+        state->killers[ply][0] = NULL_MOVE;
+        state->killers[ply][1] = NULL_MOVE;
+    }
+    memset(state->history, 0, sizeof(state->history));
+}
+
+// Searches the root with a narrow window around the previous iteration's score, which prunes far more than a full window.
+// The window is widened on whichever side the search fails, until the score lands inside it.
+BestMove _aspiration_search(
+    SearchState *state, StateRepetitions *repetitions, PlyContext *context, int32_t depth, int32_t previous_score
+) {
+    // Shallow scores are too unstable to center a window on, and mate scores are exact
+    if ((depth < ASPIRATION_MIN_DEPTH)
+        || (previous_score >= MATE_SCORE_THRESHOLD) || (previous_score <= -MATE_SCORE_THRESHOLD)
+    ) {
+        return _get_best_move_ab(state, repetitions, context, depth, 0, -SCORE_INFINITY, SCORE_INFINITY);
+    }
+
+    int32_t delta = ASPIRATION_WINDOW;
+    int32_t floor = previous_score - delta;
+    int32_t ceiling = previous_score + delta;
+    for (;;) {
+        BestMove result = _get_best_move_ab(state, repetitions, context, depth, 0, floor, ceiling);
+        if (state->stopped)
+            return result;
+
+        if (result.score <= floor) {
+            floor = (result.score - delta > -SCORE_INFINITY) ? result.score - delta : -SCORE_INFINITY;
+        } else if (result.score >= ceiling) {
+            ceiling = (result.score + delta < SCORE_INFINITY) ? result.score + delta : SCORE_INFINITY;
+        } else {
+            return result;
+        }
+        delta *= 2;
+    }
+}
+
+// Searches one ply deeper at a time, from start_depth to max_depth, until stopped.
+// Each iteration finds multi_pv lines, by searching the root again without the first move of each line found.
+// Returns the result of the deepest completed iteration.
+BestMove _iterative_deepening(
+    SearchState *state, StateRepetitions *repetitions, PlyContext *context, int32_t start_depth, int32_t max_depth
+) {
+    SearchStats *stats = &state->stats;
+    SearchLine lines[MAX_MULTI_PV];
+    BestMove best_move = {0, NULL_MOVE};
+    for (int32_t depth = start_depth; depth <= max_depth; depth++) {
+        for (uint32_t line = 0; (line < state->multi_pv) && !state->stopped; line++) {
+            // Center each line's aspiration window on its score from the previous iteration
+            bool has_previous = line < stats->n_lines;
+            state->root_move = has_previous ? stats->lines[line].pv[0] : NULL_MOVE;
+            state->n_excluded_root_moves = line;
+            BestMove result = _aspiration_search(
+                state, repetitions, context, depth, has_previous ? stats->lines[line].score : 0
+            );
+            if (state->stopped)
+                break;
+
+            state->excluded_root_moves[line] = result.move;
+            lines[line].score = result.score;
+            lines[line].pv_length = state->pv_length[0];
+            memcpy(lines[line].pv, state->pv[0], lines[line].pv_length * sizeof(Move));
+            if (lines[line].pv_length == 0) {
+                lines[line].pv[0] = result.move;
+                lines[line].pv_length = 1;
+            }
+            extend_pv_from_cache(context, lines[line].pv, &lines[line].pv_length, depth);
+        }
+        state->n_excluded_root_moves = 0;
+        // Only keep the lines of complete iterations, so that every line was searched to the same depth
+        if (state->stopped)
+            break;
+
+        memcpy(stats->lines, lines, state->multi_pv * sizeof(SearchLine));
+        stats->n_lines = state->multi_pv;
+        best_move = (BestMove){lines[0].score, lines[0].pv[0]};
+        state->root_move = best_move.move;
+        state->can_stop = true;
+
+        if (state->is_main) {
+            pthread_mutex_lock(&state->shared->progress_lock);
+            state->shared->completed_depth = depth;
+            state->shared->best_line = lines[0];
+            pthread_mutex_unlock(&state->shared->progress_lock);
+        }
+
+        if (stats->n_iterations < MAX_SEARCH_PLY) {
+            uint64_t previous_nodes = 0;
+            for (uint32_t i = 0; i < stats->n_iterations; i++) {
+                previous_nodes += stats->iteration_nodes[i];
+            }
+            stats->iteration_depths[stats->n_iterations] = depth;
+            stats->iteration_scores[stats->n_iterations] = best_move.score;
+            stats->iteration_nodes[stats->n_iterations] = stats->nodes - previous_nodes;
+            stats->n_iterations++;
+        }
+
+        // Stop once mate is certain, since deeper iterations can't improve on it
+        if ((state->multi_pv == 1)
+            && ((best_move.score >= MATE_SCORE_THRESHOLD) || (best_move.score <= -MATE_SCORE_THRESHOLD))
+        ) {
+            break;
+        }
+        // Limits only apply once pondering ends
+        if (is_pondering(state))
+            continue;
+        // Don't start an iteration that is unlikely to finish in time
+        if ((state->soft_deadline != 0) && (get_time_ms() >= state->soft_deadline))
+            break;
+        if ((state->node_limit != 0) && (ATOMIC_LOAD(&state->shared->nodes) >= state->node_limit))
+            break;
+    }
+    return best_move;
+}
+
+void *_search_helper_thread(void *arg) {
+    SearchHelper *helper = arg;
+    _iterative_deepening(&helper->state, &helper->repetitions, &helper->context, helper->start_depth, helper->max_depth);
+    return NULL;
+}
+
+// Lazy SMP: every thread searches the same root, and they share results through the move cache.
+// Helpers only exist to fill the cache, so that the main thread can skip or cut off more of its tree.
+BestMove _search(SharedSearchState *shared, StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits) {
+    uint64_t start_time = get_time_us();
+    SearchState *state = malloc(sizeof(SearchState));
+    new_search_state(state, shared, true);
+    state->node_limit = limits->nodes;
+    state->limits = *limits;
+    state->start_time = start_time / 1000;
+    state->pondering = ATOMIC_LOAD(&shared->pondering);
+    // There can't be more lines than legal moves
+    MoveList root_moves = get_all_legal_moves(context);
+    state->multi_pv = limits->multi_pv < root_moves.n_moves ? limits->multi_pv : root_moves.n_moves;
+    if (state->multi_pv < 1)
+        state->multi_pv = 1;
+    if (state->multi_pv > MAX_MULTI_PV)
+        state->multi_pv = MAX_MULTI_PV;
+    free(root_moves.moves);
+    if (!state->pondering)
+        start_search_clock(state, limits, state->start_time);
+    new_cache_search();
+
+    int32_t max_depth = limits->depth;
+    if ((max_depth < 1) || (max_depth >= MAX_SEARCH_PLY))
+        max_depth = MAX_SEARCH_PLY - 1;
+
+    // Odd helpers start one ply deeper, so that threads are spread across iterations
+    uint32_t n_helpers = n_search_threads - 1;
+    SearchHelper *helpers = malloc(sizeof(SearchHelper) * (n_helpers ? n_helpers : 1));
+    uint32_t n_started = 0;
+    for (uint32_t i = 0; i < n_helpers; i++) {
+        SearchHelper *helper = &helpers[n_started];
+        new_search_state(&helper->state, shared, false);
+        copy_state_repetitions(repetitions, &helper->repetitions);
+        copy_context(context, &helper->context);
+        helper->start_depth = (i % 2 == 0) && (max_depth > 1) ? 2 : 1;
+        helper->max_depth = max_depth;
+        if (pthread_create(&helper->thread, NULL, _search_helper_thread, helper) == 0) {
+            n_started++;
+        } else {
+            free_state_repetitions(&helper->repetitions);
+        }
+    }
+
+    StateRepetitions main_repetitions;
+    copy_state_repetitions(repetitions, &main_repetitions);
+    BestMove best_move = _iterative_deepening(state, &main_repetitions, context, 1, max_depth);
+    free_state_repetitions(&main_repetitions);
+
+    ATOMIC_STORE(&shared->stop, true);
+    // Iterations and timings come from the main thread, and counters from every thread
+    last_search_stats = state->stats;
+    for (uint32_t i = 0; i < n_started; i++) {
+        pthread_join(helpers[i].thread, NULL);
+        free_state_repetitions(&helpers[i].repetitions);
+
+        SearchStats *helper_stats = &helpers[i].state.stats;
+        last_search_stats.nodes += helper_stats->nodes;
+        last_search_stats.qnodes += helper_stats->qnodes;
+        last_search_stats.cache_probes += helper_stats->cache_probes;
+        last_search_stats.cache_hits += helper_stats->cache_hits;
+        last_search_stats.cache_collisions += helper_stats->cache_collisions;
+        last_search_stats.cutoffs += helper_stats->cutoffs;
+        last_search_stats.first_move_cutoffs += helper_stats->first_move_cutoffs;
+    }
+    last_search_stats.time_us = get_time_us() - start_time;
+    last_search_stats.profiled = state->profiled;
+    last_search_stats.cache_fill_permille = get_cache_fill_permille();
+    free(helpers);
+    free(state);
+    return best_move;
+}
+
+void new_shared_search_state(SharedSearchState *shared, bool ponder) {
+    shared->stop = false;
+    shared->pondering = ponder;
+    shared->ponder_hit_time = 0;
+    shared->nodes = 0;
+    pthread_mutex_init(&shared->progress_lock, NULL);
+    shared->completed_depth = 0;
+    shared->best_line.pv_length = 0;
+}
+
+BestMove get_best_move_ab(StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits) {
+    SharedSearchState shared;
+    new_shared_search_state(&shared, false);
+    BestMove best_move = _search(&shared, repetitions, context, limits);
+    pthread_mutex_destroy(&shared.progress_lock);
     return best_move;
 }
 
-BestMove get_best_move_ab(StateRepetitions *repetitions, PlyContext *context, int32_t depth) {
-    BestMoveCache cache = new_move_cache();
-    BestMove result = _get_best_move_ab(repetitions, context, depth, &cache, 1000000000, -1000000000);
-    free(cache.entries);
-    return result;
+///// Background Search /////
+
+typedef struct {
+    pthread_t thread;
+    // Whether a search thread has been started, and not yet waited for
+    bool running;
+    // Set by the search thread once it has a result
+    bool finished;
+    // When the search started, in milliseconds
+    uint64_t start_time;
+    SharedSearchState shared;
+    StateRepetitions repetitions;
+    PlyContext context;
+    SearchLimits limits;
+    BestMove result;
+} BackgroundSearch;
+
+static BackgroundSearch background_search = {.running = false};
+
+void *_background_search_thread(void *arg) {
+    BackgroundSearch *search = arg;
+    search->result = _search(&search->shared, &search->repetitions, &search->context, &search->limits);
+    ATOMIC_STORE(&search->finished, true);
+    return NULL;
+}
+
+bool start_search(StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits, bool ponder) {
+    if (background_search.running) {
+        stop_search();
+        wait_for_search();
+    }
+
+    new_shared_search_state(&background_search.shared, ponder);
+    background_search.finished = false;
+    background_search.start_time = get_time_ms();
+    copy_state_repetitions(repetitions, &background_search.repetitions);
+    copy_context(context, &background_search.context);
+    background_search.limits = *limits;
+    background_search.result = (BestMove){0, NULL_MOVE};
+    if (pthread_create(&background_search.thread, NULL, _background_search_thread, &background_search) != 0) {
+        free_state_repetitions(&background_search.repetitions);
+        pthread_mutex_destroy(&background_search.shared.progress_lock);
+        return false;
+    }
+    background_search.running = true;
+    return true;
+}
+
+bool is_search_running(void) {
+    return background_search.running;
+}
+
+bool is_search_finished(void) {
+    return background_search.running && ATOMIC_LOAD(&background_search.finished);
+}
+
+SearchStatus get_search_status(void) {
+    SearchStatus status;
+    status.running = background_search.running;
+    status.pondering = false;
+    status.depth = 0;
+    status.line.pv_length = 0;
+    status.nodes = 0;
+    status.time_ms = 0;
+    if (!status.running)
+        return status;
+
+    SharedSearchState *shared = &background_search.shared;
+    status.pondering = ATOMIC_LOAD(&shared->pondering);
+    pthread_mutex_lock(&shared->progress_lock);
+    status.depth = shared->completed_depth;
+    status.line = shared->best_line;
+    pthread_mutex_unlock(&shared->progress_lock);
+    status.nodes = ATOMIC_LOAD(&shared->nodes);
+    status.time_ms = get_time_ms() - background_search.start_time;
+    return status;
+}
+
+void ponder_hit(void) {
+    if (background_search.running) {
+        background_search.shared.ponder_hit_time = get_time_ms();
+        ATOMIC_STORE_RELEASE(&background_search.shared.pondering, false);
+    }
+}
+
+void stop_search(void) {
+    if (background_search.running)
+        ATOMIC_STORE(&background_search.shared.stop, true);
+}
+
+BestMove wait_for_search(void) {
+    if (!background_search.running)
+        return (BestMove){0, NULL_MOVE};
+    pthread_join(background_search.thread, NULL);
+    free_state_repetitions(&background_search.repetitions);
+    pthread_mutex_destroy(&background_search.shared.progress_lock);
+    background_search.running = false;
+    return background_search.result;
 }
\ No newline at end of file
@@ -2,29 +2,143 @@
 #define SEARCH_H
 
 #include "types.h"
+#include "config.h"
 
+// Limits on how long a search may run. A value of 0 disables a limit, except for depth.
 typedef struct {
-    ContextHash hash;
-    BestMove best_move;
-    uint8_t depth;
+    // The maximum depth (in ply) to search to
+    int32_t depth;
+    // A fixed amount of time to spend on this move, in milliseconds
+    uint64_t move_time;
+    // The time left on the clock of the side to move, and its increment per move, in milliseconds
+    uint64_t clock_time;
+    uint64_t clock_increment;
+    // The maximum number of nodes to search
+    uint64_t nodes;
+    // The number of best lines to find, up to MAX_MULTI_PV. Each line excludes the first moves of the lines before it.
+    uint32_t multi_pv;
+} SearchLimits;
 
-    // TODO: Re-enable
-    // int32_t floor;
-    // int32_t ceiling;
+// Limits that search to MOVE_SEARCH_DEPTH for a single line, with no time or node limits
+SearchLimits new_search_limits(void);
 
-    // Whether or not this move is a leaf in the search tree
-    bool is_leaf;
-} BestMoveCacheEntry;
+// The deadlines of a search with these limits that starts at the given time, in milliseconds. 0 means there is no deadline.
+// No new iteration should start after the soft deadline, and the search should be aborted at the hard deadline.
+void get_search_deadlines(SearchLimits *limits, uint64_t now, uint64_t *soft_deadline, uint64_t *hard_deadline);
 
-// const int BestMoveCacheEntrySize = sizeof(BestMoveCacheEntry);
+// Forward pruning techniques that can be toggled at runtime, to measure their effect
+typedef struct {
+    // Skip quiet moves near the horizon when the static evaluation is far below the floor
+    bool futility_pruning;
+    // Replace shallow searches with a quiescence search when the static evaluation is far below the floor
+    bool razoring;
+    // Skip quiet moves near the horizon once enough moves have been searched
+    bool late_move_pruning;
+} PruningOptions;
+
+// The pruning options used by all searches, which may be modified between searches
+PruningOptions *get_pruning_options(void);
+
+// A line of play found by the search, and its score
+typedef struct {
+    int32_t score;
+    // The principal variation, starting with the move at the root
+    Move pv[MAX_SEARCH_PLY];
+    uint32_t pv_length;
+} SearchLine;
 
+// Statistics from a single search, summed over every search thread
 typedef struct {
-    BestMoveCacheEntry *entries;
-} BestMoveCache;
+    // All nodes searched, including quiescence nodes
+    uint64_t nodes;
+    // Nodes searched by the quiescence search
+    uint64_t qnodes;
+
+    uint64_t cache_probes;
+    uint64_t cache_hits;
+    // Cache hits whose move was illegal in the probed position, meaning that two positions shared a key.
+    // Only collisions that are detected this way are counted.
+    uint64_t cache_collisions;
+    // The permille of sampled cache entries written during this search
+    uint32_t cache_fill_permille;
+
+    // Nodes where a move failed high, and how many of those failed high on the first move searched
+    uint64_t cutoffs;
+    uint64_t first_move_cutoffs;
+
+    // Wall time of the search, in microseconds
+    uint64_t time_us;
+    // Whether time spent in move generation and evaluation was measured, since timing every call slows the search
+    bool profiled;
+    // Time the main thread spent in move generation and evaluation, in microseconds
+    uint64_t movegen_time_us;
+    uint64_t eval_time_us;
+
+    // The depth, score, and nodes searched by the main thread, for each completed iteration
+    uint32_t n_iterations;
+    int32_t iteration_depths[MAX_SEARCH_PLY];
+    int32_t iteration_scores[MAX_SEARCH_PLY];
+    uint64_t iteration_nodes[MAX_SEARCH_PLY];
+
+    // The best lines of the deepest completed iteration, best first. Only multi-PV searches find more than one.
+    SearchLine lines[MAX_MULTI_PV];
+    uint32_t n_lines;
+} SearchStats;
+
+// Statistics from the most recent search
+SearchStats *get_last_search_stats(void);
+
+// Enable or disable timing move generation and evaluation in later searches
+void set_search_profiling(bool enabled);
+
+bool get_search_profiling(void);
+
+// Precompute search tables
+void init_search(void);
+
+// Set the number of threads that searches use. This is clamped between 1 and MAX_SEARCH_THREADS.
+void set_search_threads(uint32_t n_threads);
+
+uint32_t get_search_threads(void);
+
+// Minimax search with alpha-beta pruning, using iterative deepening until a limit is reached.
+// Returns the best move from the deepest completed iteration.
+BestMove get_best_move_ab(StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits);
+
+// Start a search like get_best_move_ab on a background thread, stopping any search already running.
+// When pondering, the search ignores its limits until ponder_hit is called, and its time limits count from then.
+// Returns false if the thread could not be started.
+bool start_search(StateRepetitions *repetitions, PlyContext *context, SearchLimits *limits, bool ponder);
+
+// Whether a background search has been started, and not yet waited for. It may have already finished.
+bool is_search_running(void);
+
+// Whether a background search has been started, and has a result ready to be waited for
+bool is_search_finished(void);
+
+// The progress of the background search
+typedef struct {
+    // Whether a background search is running, and whether it is still pondering
+    bool running;
+    bool pondering;
+    // The deepest iteration completed so far, and its best line. The depth is 0 until the first iteration completes.
+    int32_t depth;
+    SearchLine line;
+    // Nodes searched by every thread, which is only updated every SEARCH_CHECK_INTERVAL nodes per thread
+    uint64_t nodes;
+    // Time since the search started, in milliseconds
+    uint64_t time_ms;
+} SearchStatus;
+
+SearchStatus get_search_status(void);
+
+// The move being pondered on was played, so start enforcing the background search's limits, timed from now
+void ponder_hit(void);
 
-BestMoveCache new_move_cache(void);
+// Ask the background search to stop as soon as possible
+void stop_search(void);
 
-// Minimax search with alpha-beta pruning
-BestMove get_best_move_ab(StateRepetitions *repetitions, PlyContext *context, int32_t depth);
+// Wait for the background search to finish, and return its result
+BestMove wait_for_search(void);
 
 #endif
\ No newline at end of file
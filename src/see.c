@@ -0,0 +1,99 @@
+#include "see.h"
+#include "config.h"
+#include "eval.h"
+#include "order.h"
+#include "precomp.h"
+#include "position.h"
+
+// The longest possible exchange, since every capture removes a piece
+#define MAX_EXCHANGE_LENGTH 32
+
+// Whether the piece attacks the square, given which squares are occupied.
+// Sliding pieces are blocked by any occupied square in between.
+bool attacks_square(Piece piece, bool is_white, uint8_t pos, uint64_t occupied) {
+    uint8_t piece_pos = GET_PIECE_POS(piece);
+    if ((get_piece_possible_attack_bb(piece, is_white) & GET_POS_BB_MASK(pos)) == 0)
+        return false;
+    if ((piece.type == Bishop) || (piece.type == Rook) || (piece.type == Queen))
+        return (BETWEEN_BB_TABLE[piece_pos][pos] & occupied) == 0;
+    return true;
+}
+
+// Finds the least valuable piece that attacks the square, among pieces that are still on an occupied square.
+// Returns -1 if there is none.
+int find_least_valuable_attacker(Piece *pieces, bool is_white, uint8_t pos, uint64_t occupied) {
+    int best_i = -1;
+    int32_t best_value = 0;
+    for (int i = 0; i < 16; i++) {
+        Piece piece = pieces[i];
+        if ((piece.type == NullPiece) || ((GET_PIECE_BB_MASK(piece) & occupied) == 0))
+            continue;
+        // The king can't be captured, so it is the most valuable attacker
+        int32_t value = piece.type == King ? QUEEN_BASE_VALUE * 2 : get_piece_type_value(piece.type);
+        if (((best_i == -1) || (value < best_value)) && attacks_square(piece, is_white, pos, occupied)) {
+            best_i = i;
+            best_value = value;
+        }
+    }
+    return best_i;
+}
+
+int32_t see(PlyContext *context, Move move) {
+    uint8_t pos = GET_MOVE_POS(move);
+    Piece mover = context->our_pieces[move.piece_id];
+    uint64_t occupied = context->piece_bb ^ GET_PIECE_BB_MASK(mover);
+
+    // gains[i] is the material gained by the side making the i-th capture, if the exchange stopped there
+    int32_t gains[MAX_EXCHANGE_LENGTH];
+    if (move.special_move == EnPassant) {
+        gains[0] = PAWN_BASE_VALUE;
+        occupied ^= GET_POS_BB_MASK((mover.y << 3) + move.to_x);
+    } else {
+        gains[0] = get_piece_type_value(get_captured_piece_type(context, move));
+    }
+    // The piece left on the target square, which is the next to be captured
+    PieceType on_square = mover.type;
+    if ((move.special_move >= PromoteKnight) && (move.special_move <= PromoteQueen)) {
+        on_square = move.special_move;
+        gains[0] += get_piece_type_value(on_square) - PAWN_BASE_VALUE;
+    }
+
+    // Alternate captures, starting with the opponent
+    Piece *sides[2] = {context->opponent_pieces, context->our_pieces};
+    bool side_is_white[2] = {!context->is_white, context->is_white};
+    int n = 1;
+    for (; n < MAX_EXCHANGE_LENGTH; n++) {
+        int side = (n - 1) & 1;
+        int attacker_i = find_least_valuable_attacker(sides[side], side_is_white[side], pos, occupied);
+        if (attacker_i == -1)
+            break;
+        Piece attacker = sides[side][attacker_i];
+        // The king may only capture if the other side has nothing left to recapture with
+        if (attacker.type == King) {
+            uint64_t without_king = occupied ^ GET_PIECE_BB_MASK(attacker);
+            if (find_least_valuable_attacker(sides[side ^ 1], side_is_white[side ^ 1], pos, without_king) != -1)
+                break;
+        }
+
+        gains[n] = get_piece_type_value(on_square) - gains[n - 1];
+        occupied ^= GET_PIECE_BB_MASK(attacker);
+        on_square = attacker.type;
+    }
+
+    // Each side can choose to stop capturing, if continuing would lose material
+    while (--n > 0) {
+        if (-gains[n] < gains[n - 1])
+            gains[n - 1] = -gains[n];
+    }
+    return gains[0];
+}
+
+bool is_losing_capture(PlyContext *context, Move move) {
+    if (move.special_move == EnPassant)
+        return see(context, move) < 0;
+    PieceType attacker = context->our_pieces[move.piece_id].type;
+    PieceType victim = get_captured_piece_type(context, move);
+    if ((attacker == King) || (get_piece_type_value(victim) >= get_piece_type_value(attacker)))
+        return false;
+    return see(context, move) < 0;
+}
@@ -0,0 +1,16 @@
+#ifndef SEE_H
+#define SEE_H
+
+#include "types.h"
+
+// Static exchange evaluation: the material gained by a move, in base piece values, assuming that both sides then
+// keep recapturing on the target square with their least valuable piece, for as long as it gains them material.
+// Attackers hidden behind other attackers (x-rays) join in as the pieces in front of them capture.
+// Pins and checks are ignored.
+int32_t see(PlyContext *context, Move move);
+
+// Whether a capture loses material, according to static exchange evaluation.
+// Captures of a piece worth at least as much as the capturing piece never lose material, so they are not evaluated.
+bool is_losing_capture(PlyContext *context, Move move);
+
+#endif
@@ -0,0 +1,13 @@
+#include <time.h>
+
+#include "timer.h"
+
+uint64_t get_time_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+uint64_t get_time_ms(void) {
+    return get_time_us() / 1000;
+}
\ No newline at end of file
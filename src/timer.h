@@ -0,0 +1,12 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Milliseconds elapsed on a monotonic clock, from an arbitrary starting point
+uint64_t get_time_ms(void);
+
+// Microseconds elapsed on a monotonic clock, from an arbitrary starting point
+uint64_t get_time_us(void);
+
+#endif
\ No newline at end of file
@@ -62,10 +62,8 @@ typedef struct {
     Move move;
 } BestMove;
 
-typedef struct {
-    int64_t alpha;
-    int64_t beta;
-} ContextHash;
+// A Zobrist hash of a position
+typedef uint64_t ContextHash;
 
 typedef struct {
     // White pieces
@@ -94,12 +92,24 @@ typedef struct {
     uint64_t opponent_bb;
 
     ContextHash hash;
+    // A hash of the pawns alone, which keys the cached pawn structure evaluation
+    ContextHash pawn_hash;
+    // The number of plies since the last irreversible move (a capture, pawn move or change of castling rights).
+    // No earlier position can repeat, so repetition checks only need to look back this far.
+    uint16_t reversible_plies;
+    // Piece-square scores of each side, including material, for the middlegame and the endgame, indexed by is_white.
+    // These are updated as pieces move, and blended by the game phase when evaluating.
+    int32_t middlegame_scores[2];
+    int32_t endgame_scores[2];
+    // The non-pawn material on the board, weighted by GAME_PHASE_WEIGHTS. It starts at MAX_GAME_PHASE,
+    // falls as pieces are traded, and can exceed MAX_GAME_PHASE after promotions.
+    uint8_t game_phase;
 } PlyContext;
 
+// A stack of the hashes of every position preceding the current one, oldest first
 typedef struct {
     ContextHash *hashes;
-    uint8_t *entries;
-    uint32_t n_entries;
+    uint32_t length;
 } StateRepetitions;
 
 typedef struct {
@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "context.h"
+#include "game.h"
+#include "types.h"
+#include "movegen.h"
+#include "search.h"
+#include "eval.h"
+#include "config.h"
+#include "precomp.h"
+#include "hash.h"
+#include "history.h"
+#include "cache.h"
+#include "mate.h"
+#include "see.h"
+#include "position.h"
+#include "constants.h"
+
+// Regression checks, run by CTest. Each suite is selected by name on the command line, and exits with a nonzero status
+// if any of its checks fail.
+
+int n_failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            n_failures++; \
+        } \
+    } while (0)
+
+void init(void) {
+    init_precomp();
+    init_eval();
+    init_hashing();
+    init_cache();
+    init_search();
+}
+
+// Puts a piece in the slot that the game would have given it: the king in slot 4, rooks in the corner slots, pawns in
+// the slot of their file, and the others in their starting slots, falling back to any free slot
+bool place_piece(Piece *pieces, Piece piece) {
+    int preferred[2] = {-1, -1};
+    switch (piece.type) {
+        case King:
+            preferred[0] = 4;
+            break;
+        case Pawn:
+            preferred[0] = 8 + piece.x;
+            break;
+        case Knight:
+            preferred[0] = 1;
+            preferred[1] = 6;
+            break;
+        case Bishop:
+            preferred[0] = 2;
+            preferred[1] = 5;
+            break;
+        case Rook:
+            preferred[0] = piece.x < 4 ? 0 : 7;
+            preferred[1] = piece.x < 4 ? 7 : 0;
+            break;
+        case Queen:
+            preferred[0] = 3;
+            break;
+    }
+    for (int i = 0; i < 2; i++) {
+        if ((preferred[i] != -1) && (pieces[preferred[i]].type == NullPiece)) {
+            pieces[preferred[i]] = piece;
+            return true;
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        if ((i != 4) && (pieces[i].type == NullPiece)) {
+            pieces[i] = piece;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sets up a position from the piece placement, side to move and castling fields of a FEN string.
+// En passant and the move counters are ignored.
+bool load_fen(PlyContext *context, const char *fen) {
+    new_context(context);
+    for (int i = 0; i < 16; i++) {
+        context->white_pieces[i].type = NullPiece;
+        context->black_pieces[i].type = NullPiece;
+    }
+
+    int x = 0, y = 7;
+    const char *c = fen;
+    for (; (*c != '\0') && (*c != ' '); c++) {
+        if (*c == '/') {
+            x = 0;
+            y--;
+        } else if ((*c >= '1') && (*c <= '8')) {
+            x += *c - '0';
+        } else {
+            const char *types = " kpnbrq";
+            const char *found = strchr(types, *c | 0x20);
+            if ((found == NULL) || (*found == ' ') || (x > 7) || (y < 0))
+                return false;
+            Piece piece = {found - types, x, y};
+            bool is_white = (*c >= 'A') && (*c <= 'Z');
+            if (!place_piece(is_white ? context->white_pieces : context->black_pieces, piece))
+                return false;
+            x++;
+        }
+    }
+
+    context->is_white = strncmp(c, " b", 2) != 0;
+    const char *castling = *c == '\0' ? "" : c + 3;
+    context->white_can_castle_king_side = false;
+    context->white_can_castle_queen_side = false;
+    context->black_can_castle_king_side = false;
+    context->black_can_castle_queen_side = false;
+    for (; (*castling != '\0') && (*castling != ' '); castling++) {
+        context->white_can_castle_king_side |= *castling == 'K';
+        context->white_can_castle_queen_side |= *castling == 'Q';
+        context->black_can_castle_king_side |= *castling == 'k';
+        context->black_can_castle_queen_side |= *castling == 'q';
+    }
+
+    context->our_pieces = context->is_white ? context->white_pieces : context->black_pieces;
+    context->opponent_pieces = context->is_white ? context->black_pieces : context->white_pieces;
+    context->our_bb = 0;
+    context->opponent_bb = 0;
+    for (int i = 0; i < 16; i++) {
+        if (context->our_pieces[i].type != NullPiece)
+            context->our_bb |= GET_PIECE_BB_MASK(context->our_pieces[i]);
+        if (context->opponent_pieces[i].type != NullPiece)
+            context->opponent_bb |= GET_PIECE_BB_MASK(context->opponent_pieces[i]);
+    }
+    context->piece_bb = context->our_bb | context->opponent_bb;
+    context->hash = get_context_hash(context);
+    context->reversible_plies = 0;
+    init_piece_scores(context);
+    return true;
+}
+
+// Finds the legal move with the given code (e.g., e2e4, g7g8q). Returns false if there is none.
+bool find_move(PlyContext *context, const char *code, Move *move) {
+    MoveList legal_moves = get_all_legal_moves(context);
+    bool found = false;
+    char move_code[6];
+    for (int i = 0; (i < legal_moves.n_moves) && !found; i++) {
+        get_move_code(context, legal_moves.moves[i], move_code);
+        if (strcmp(move_code, code) == 0) {
+            *move = legal_moves.moves[i];
+            found = true;
+        }
+    }
+    free(legal_moves.moves);
+    return found;
+}
+
+// Plays a space-separated list of moves, where "null" passes the turn, recording each position left behind the way
+// the game and the search do. Returns false at the first illegal move.
+bool play_moves(PlyContext *context, StateRepetitions *repetitions, const char *moves) {
+    char line[256];
+    strncpy(line, moves, sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    for (char *token = strtok(line, " "); token != NULL; token = strtok(NULL, " ")) {
+        Move move = NULL_MOVE;
+        if ((strcmp(token, "null") != 0) && !find_move(context, token, &move))
+            return false;
+        push_state_repetition(repetitions, context->hash);
+        update_context_no_prefetch(context, move);
+    }
+    return true;
+}
+
+// Whether the side to move has been checkmated
+bool is_checkmate(PlyContext *context) {
+    return is_in_check(context) && !has_legal_move(context);
+}
+
+///// Perft /////
+
+typedef struct {
+    const char *fen;
+    uint8_t depth;
+    uint64_t nodes;
+} PerftCase;
+
+void test_perft(void) {
+    const PerftCase cases[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 1, 20},
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 2, 400},
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 3, 8902},
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 4, 197281},
+        // Castling both ways for both sides, pins and promotions
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 1, 48},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 2, 2039},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 3, 97862},
+        // Capturing rooks before they castle, and promoting by capture
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq -", 3, 9467},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ -", 3, 62379},
+        // Discovered checks and en passant captures along the king's rank
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", 4, 43238},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", 5, 674624},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        PlyContext context;
+        CHECK(load_fen(&context, cases[i].fen), "invalid FEN '%s'", cases[i].fen);
+        uint64_t nodes = perft(&context, cases[i].depth);
+        CHECK(nodes == cases[i].nodes, "perft %d of '%s' found %lu nodes, expected %lu",
+            cases[i].depth, cases[i].fen, nodes, cases[i].nodes);
+    }
+}
+
+///// Static Exchange Evaluation /////
+
+typedef struct {
+    const char *fen;
+    const char *move;
+    int32_t value;
+} SeeCase;
+
+void test_see(void) {
+    const SeeCase cases[] = {
+        // An undefended pawn
+        {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - -", "e1e5", PAWN_BASE_VALUE},
+        // A defended pawn, recaptured by the rook behind the first
+        {"6k1/8/3p4/4p3/8/8/4R3/4R1K1 w - -", "e2e5", 2 * PAWN_BASE_VALUE - ROOK_BASE_VALUE},
+        // The rook behind the first wins the exchange
+        {"4r1k1/8/8/4p3/8/8/4R3/4R1K1 w - -", "e2e5", PAWN_BASE_VALUE},
+        // Unless the defender has a queen behind its rook
+        {"4q1k1/4r3/8/4p3/8/8/4R3/4R1K1 w - -", "e2e5", PAWN_BASE_VALUE - ROOK_BASE_VALUE},
+        // Queens behind both a rook and a bishop join in, so the knight is lost for a pawn
+        {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - -", "d3e5", PAWN_BASE_VALUE - KNIGHT_BASE_VALUE},
+        // The queen behind the bishop on the diagonal wins back the knight
+        {"6k1/8/2n5/4p3/3B4/2Q5/8/6K1 w - -", "d4e5", PAWN_BASE_VALUE - BISHOP_BASE_VALUE + KNIGHT_BASE_VALUE},
+        // The king recaptures, unless the rook behind the first still defends the square
+        {"8/8/4k3/4p3/8/8/4R3/4K3 w - -", "e2e5", PAWN_BASE_VALUE - ROOK_BASE_VALUE},
+        {"8/8/4k3/4p3/8/8/4R3/4R1K1 w - -", "e2e5", PAWN_BASE_VALUE},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        PlyContext context;
+        Move move;
+        CHECK(load_fen(&context, cases[i].fen), "invalid FEN '%s'", cases[i].fen);
+        if (!find_move(&context, cases[i].move, &move)) {
+            CHECK(false, "%s is not legal in '%s'", cases[i].move, cases[i].fen);
+            continue;
+        }
+        int32_t value = see(&context, move);
+        CHECK(value == cases[i].value, "SEE of %s in '%s' is %d, expected %d",
+            cases[i].move, cases[i].fen, value, cases[i].value);
+        CHECK(is_losing_capture(&context, move) == (value < 0), "%s in '%s' should%s be a losing capture",
+            cases[i].move, cases[i].fen, value < 0 ? "" : " not");
+    }
+}
+
+///// Mate Search /////
+
+typedef struct {
+    const char *fen;
+    uint32_t max_moves;
+    MateSearchStatus status;
+    uint32_t n_moves;
+} MateCase;
+
+void test_mate(void) {
+    const MateCase cases[] = {
+        // Back rank mate
+        {"6k1/5ppp/8/8/8/8/8/R5K1 w - -", 3, MateFound, 1},
+        // Rook rollers, where checking first only lets the king escape
+        {"7k/8/8/8/8/8/R7/1R4K1 w - -", 3, MateFound, 2},
+        {"8/8/7k/8/8/8/1R6/R5K1 w - -", 3, MateFound, 3},
+        // A queen sacrifice opens the king to a discovered attack
+        {"r1b3kr/ppp1Bp1p/1b6/n2P4/2p3q1/2Q2N2/P4PPP/RN2R1K1 w - -", 3, MateFound, 3},
+        // Smothered mates, the second after a queen sacrifice forces the rook onto the king's last flight square
+        {"r5rk/6pp/7N/8/8/1Q6/6PP/6K1 w - -", 3, MateFound, 1},
+        {"2r4k/6pp/8/4N3/8/1Q6/6PP/6K1 w - -", 4, MateFound, 4},
+        // The mate is one move too far away
+        {"2r4k/6pp/8/4N3/8/1Q6/6PP/6K1 w - -", 3, MateNotFound, 0},
+        // Black to move mates
+        {"r5k1/8/8/8/8/8/5PPP/6K1 b - -", 3, MateFound, 1},
+        // Stalemate isn't mate
+        {"7k/5Q2/6K1/8/8/8/8/8 b - -", 3, MateNotFound, 0},
+        // Neither side can force mate quickly from the start
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", 2, MateNotFound, 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        PlyContext context;
+        CHECK(load_fen(&context, cases[i].fen), "invalid FEN '%s'", cases[i].fen);
+        MateSearchResult result = find_mate(&context, cases[i].max_moves);
+        CHECK(result.status == cases[i].status, "mate search of '%s' ended with status %d, expected %d",
+            cases[i].fen, result.status, cases[i].status);
+        if ((result.status != MateFound) || (cases[i].status != MateFound))
+            continue;
+        CHECK(result.n_moves == cases[i].n_moves, "'%s' is mate in %u, expected %u",
+            cases[i].fen, result.n_moves, cases[i].n_moves);
+
+        // The line must be legal, and end in mate after the given number of our moves
+        CHECK(result.line_length == 2 * cases[i].n_moves - 1, "mating line of '%s' has %u plies, expected %u",
+            cases[i].fen, result.line_length, 2 * cases[i].n_moves - 1);
+        PlyContext position;
+        copy_context(&context, &position);
+        char code[6];
+        for (uint32_t ply = 0; ply < result.line_length; ply++) {
+            get_move_code(&position, result.line[ply], code);
+            Move move;
+            if (!find_move(&position, code, &move)) {
+                CHECK(false, "mating line of '%s' plays illegal move %s", cases[i].fen, code);
+                break;
+            }
+            update_context_no_prefetch(&position, move);
+        }
+        CHECK(is_checkmate(&position), "mating line of '%s' doesn't end in mate", cases[i].fen);
+    }
+}
+
+///// Repetitions /////
+
+// The number of times the current position has occurred, after playing the moves from the position
+uint8_t count_repetitions(const char *fen, const char *moves) {
+    PlyContext context;
+    StateRepetitions repetitions;
+    new_state_repetitions(&repetitions);
+    CHECK(load_fen(&context, fen), "invalid FEN '%s'", fen);
+    CHECK(play_moves(&context, &repetitions, moves), "illegal moves '%s' in '%s'", moves, fen);
+    uint8_t n_repetitions = n_state_repetitions(&repetitions, &context);
+    CHECK(is_repetition_draw(&repetitions, &context) == (n_repetitions >= N_REPETITIONS_DRAW),
+        "repetition draw disagrees with %u repetitions after '%s'", n_repetitions, moves);
+    free_state_repetitions(&repetitions);
+    return n_repetitions;
+}
+
+typedef struct {
+    const char *fen;
+    const char *moves;
+    uint8_t n_repetitions;
+} RepetitionCase;
+
+void test_repetition(void) {
+    const char *start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -";
+    const char *open = "r3k3/8/8/8/8/8/8/4K2R w Kq -";
+    const RepetitionCase cases[] = {
+        {start, "", 1},
+        {start, "g1f3 g8f6 f3g1 f6g8", 2},
+        {start, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1 f6g8", 3},
+        // Positions in the middle of the cycle repeat too
+        {start, "g1f3 g8f6 f3g1 f6g8 g1f3", 2},
+        {start, "g1f3 g8f6 f3g1 f6g8 g1f3 g8f6 f3g1", 2},
+        // Losing castling rights changes the position
+        {open, "e1e2 e8e7 e2e1 e7e8", 1},
+        {open, "e1e2 e8e7 e2e1 e7e8 e1e2 e8e7 e2e1 e7e8", 2},
+        // A capture is irreversible, so positions before it are never counted, and those after it still are
+        {"4k3/8/8/8/8/8/r7/R3K3 w - -", "e1d1 e8d8 d1e1 d8e8 a1a2", 1},
+        {"4k3/8/8/8/8/8/r7/R3K3 w - -", "a1a2 e8d8 e1d1 d8e8 d1e1 e8d8 e1d1 d8e8 d1e1", 3},
+        {"4k3/8/8/8/8/8/r7/R3K3 w - -", "e1d1 e8d8 d1e1 d8e8 a1a2 e8d8 e1d1 d8e8 d1e1", 2},
+        // Null moves are irreversible too, since the searches on either side of them are different games
+        {start, "g1f3 null f3g1 null", 1},
+        {start, "g1f3 g8f6 f3g1 f6g8 null g8f6 null f6g8", 1},
+        {start, "null g8f6 g1f3 f6g8 f3g1 g8f6 g1f3 f6g8 f3g1", 3},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint8_t n_repetitions = count_repetitions(cases[i].fen, cases[i].moves);
+        CHECK(n_repetitions == cases[i].n_repetitions, "found %u repetitions after '%s' in '%s', expected %u",
+            n_repetitions, cases[i].moves, cases[i].fen, cases[i].n_repetitions);
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} TestSuite;
+
+const TestSuite TEST_SUITES[] = {
+    {"perft", test_perft},
+    {"see", test_see},
+    {"mate", test_mate},
+    {"repetition", test_repetition},
+};
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        printf("Usage: %s <suite>\n", argv[0]);
+        return 2;
+    }
+    init();
+    for (size_t i = 0; i < sizeof(TEST_SUITES) / sizeof(TEST_SUITES[0]); i++) {
+        if (strcmp(argv[1], TEST_SUITES[i].name) == 0) {
+            TEST_SUITES[i].run();
+            printf("%s: %d failure%s\n", argv[1], n_failures, n_failures == 1 ? "" : "s");
+            return n_failures == 0 ? 0 : 1;
+        }
+    }
+    printf("Unknown test suite '%s'.\n", argv[1]);
+    return 2;
+}